@@ -1,5 +1,10 @@
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <sstream>
 #include <string>
-#include <thread>
+#include <unordered_set>
 
 #include "sz/sz.hpp"
 
@@ -15,27 +20,258 @@ int main(int argc, char** argv) {
       ->required();
 
   std::vector<std::string> source_filenames;
-  app.add_option<std::vector<std::string>>("source", source_filenames,
-                                           "The source file(s) to be compressed.")
-      ->required();
+  app.add_option<std::vector<std::string>>(
+      "source", source_filenames,
+      "The source file(s) to be compressed, or the entries to be extracted "
+      "(default: all entries)");
 
   app.add_flag("-v,--verbose", sz::log_info_switch, "Verbose mode");
 
   std::string arg_compress_method;
   app.add_option("-m,--method", arg_compress_method, "store | deflate (default: deflate)");
 
-  app.add_flag("--deflate_static", sz::deflate_use_static,
+  sz::CompressionOptions options;
+  app.add_flag("--deflate_static", options.use_static,
                "Use static encoding (for deflate)");
-  app.add_option<int>("-l,--level", sz::deflate_lz77_level,
+  app.add_option<int>("-l,--level", options.lz77_level,
                       "Level of LZ77 (0..3), default: 1")
       ->check(CLI::Range(0, 3));
 
-  size_t thread_cnt = std::thread::hardware_concurrency();
+  app.add_flag("--sections", options.sync_sections,
+               "End deflate blocks on byte boundaries and index them, so that "
+               "an entry can be extracted in parallel");
+  size_t section_mb = 0;
+  app.add_option<size_t>("--section-size", section_mb,
+                         "Minimum MB of content per section, implies "
+                         "--sections (default: 1)")
+      ->check(CLI::PositiveNumber);
+
+  size_t thread_cnt = sz::cpu::available_cpus();
   app.add_option<size_t>("-t,--thread", thread_cnt,
                          "number of threads used (for deflate)");
 
+  app.add_flag("--pin", options.pin_workers,
+               "Pin the deflate workers to CPUs, keeping their buffers on the "
+               "local NUMA node");
+
+  std::string cache_dir;
+  app.add_option("--cache", cache_dir,
+                 "Keep the compressed files in this directory, and reuse them "
+                 "for files of the same content");
+
+  size_t max_memory_mb = 0;
+  app.add_option<size_t>("--max-memory", max_memory_mb,
+                         "Keep the memory use under this many MB, by running "
+                         "fewer threads at a time and streaming the archive "
+                         "if needed")
+      ->check(CLI::PositiveNumber);
+
+  std::string stats_filename;
+  app.add_option("--stats", stats_filename,
+                 "Write statistics of every entry and deflate block to this "
+                 "file, as CSV if it ends with .csv, or else as JSON");
+
+  std::string trace_filename;
+  app.add_option("--trace", trace_filename,
+                 "Write a timeline of the threads to this file, as trace "
+                 "event JSON for chrome://tracing or Perfetto");
+
+  bool stream_mode = false;
+  app.add_flag("-s,--stream", stream_mode,
+               "Write each entry to the target as soon as it is compressed");
+
+  bool parallel_write = false;
+  app.add_flag("-p,--parallel-write", parallel_write,
+               "Write the entries to the target in parallel at their offsets");
+
+  bool update_mode = false;
+  app.add_flag("-u,--update", update_mode,
+               "Rewrite the target with the given source file(s), copying the "
+               "entries of unchanged files without compressing them again");
+
+  bool merge_mode = false;
+  app.add_flag("-M,--merge", merge_mode,
+               "Build the target from the entries of the source archive(s), "
+               "copying them without recompression");
+
+  std::vector<std::string> merge_entries;
+  app.add_option<std::vector<std::string>>(
+      "-e,--entry", merge_entries,
+      "With --merge, the entries to be copied, in this order, each from the "
+      "first source archive that has it (default: all entries)");
+
+  bool extract_mode = false;
+  app.add_flag("-x,--extract", extract_mode,
+               "Extract the entries of the target in parallel");
+
+  bool test_mode = false;
+  app.add_flag("-T,--test", test_mode,
+               "Verify the entries of the target in parallel without writing "
+               "them");
+
+  std::string extract_dir = ".";
+  app.add_option("-C,--directory", extract_dir,
+                 "The directory to extract to (default: .)");
+
   CLI11_PARSE(app, argc, argv)
 
+  // Records until main returns, and then writes the timeline.
+  const sz::trace::Session trace_session(trace_filename);
+  sz::memory::set_budget(static_cast<sz::uint64>(max_memory_mb) << 20);
+
+  const auto write_stats =
+      [&stats_filename](const std::vector<sz::EntryStats>& stats) {
+        if (stats_filename.empty()) {
+          return;
+        }
+        std::ofstream ofs(stats_filename);
+        if (!ofs) {
+          sz::log::panic("cannot write to file '", stats_filename, "'");
+        }
+        const std::string ext = ".csv";
+        if (stats_filename.size() >= ext.size() &&
+            stats_filename.compare(stats_filename.size() - ext.size(),
+                                   ext.size(), ext) == 0) {
+          sz::write_stats_csv(ofs, stats);
+        } else {
+          sz::write_stats_json(ofs, stats);
+        }
+      };
+  const auto log_memory = [] {
+    std::ostringstream os;
+    sz::memory::write_report(os, sz::memory::report());
+    sz::log::log("Peak memory: ", os.str());
+  };
+
+  if (test_mode) {
+    auto start = std::chrono::system_clock::now();
+
+    sz::ZipReader reader(target_filename);
+    if (!reader.is_open()) {
+      sz::log::panic("cannot read zip file '", target_filename, "'");
+    }
+    const sz::UnzipReport report =
+        sz::Unzipper(reader, thread_cnt).test(source_filenames);
+
+    auto end = std::chrono::system_clock::now();
+    std::chrono::duration<double> elapsed_seconds = end - start;
+    for (const auto& name : report.failures) {
+      std::cerr << "bad entry '" << name << "'" << std::endl;
+    }
+    std::cerr << "Tested " << report.n_entries << " entries, "
+              << report.n_bytes << " bytes in " << std::fixed
+              << std::setprecision(2) << elapsed_seconds.count() << "s ("
+              << static_cast<double>(report.n_bytes) / (1 << 20) /
+                     std::max(elapsed_seconds.count(), 1e-6)
+              << " MB/s)" << std::endl;
+
+    std::cerr << "testing zip ... "
+              << (report.failures.empty() ? "success" : "fail") << std::endl;
+    return report.failures.empty() ? 0 : 1;
+  }
+
+  if (extract_mode) {
+    auto start = std::chrono::system_clock::now();
+
+    sz::ZipReader reader(target_filename);
+    if (!reader.is_open()) {
+      sz::log::panic("cannot read zip file '", target_filename, "'");
+    }
+    sz::log::log("Extract: use ", thread_cnt, " thread(s)");
+    const sz::UnzipReport report =
+        sz::Unzipper(reader, thread_cnt).extract(source_filenames, extract_dir);
+
+    auto end = std::chrono::system_clock::now();
+    std::chrono::duration<double> elapsed_seconds = end - start;
+    sz::log::log("Time used: ", std::fixed, std::setprecision(2),
+                 elapsed_seconds.count(), "s");
+    sz::log::log("Extracted ", report.n_entries, " entries, ", report.n_bytes,
+                 " bytes");
+    for (const auto& name : report.failures) {
+      std::cerr << "cannot extract '" << name << "'" << std::endl;
+    }
+
+    std::cerr << "extracting zip ... "
+              << (report.failures.empty() ? "success" : "fail") << std::endl;
+    return report.failures.empty() ? 0 : 1;
+  }
+
+  if (merge_mode) {
+    auto start = std::chrono::system_clock::now();
+
+    std::vector<std::unique_ptr<sz::ZipReader>> readers;
+    for (auto&& source_filename : source_filenames) {
+      readers.push_back(std::make_unique<sz::ZipReader>(source_filename));
+      if (!readers.back()->is_open()) {
+        sz::log::panic("cannot read zip file '", source_filename, "'");
+      }
+    }
+    // The target may be one of the sources, so it is replaced at the end.
+    const std::string tmp_filename = target_filename + ".tmp";
+    sz::ZipWriter writer(tmp_filename);
+    if (!writer.is_open()) {
+      sz::log::panic("cannot write to file '", tmp_filename, "'");
+    }
+
+    bool ok = true;
+    if (merge_entries.empty()) {
+      // Entries of the same name are taken from the first archive.
+      std::unordered_set<std::string> copied;
+      for (auto&& reader : readers) {
+        for (size_t i = 0; i < reader->n_entries(); ++i) {
+          const sz::ZipReader::Entry& entry = reader->entry(i);
+          if (copied.emplace(reader->name(entry)).second &&
+              !writer.add_raw_entry(*reader, entry)) {
+            std::cerr << "cannot copy '" << reader->name(entry) << "'"
+                      << std::endl;
+            ok = false;
+          }
+        }
+      }
+    } else {
+      for (auto&& name : merge_entries) {
+        const sz::ZipReader* from = nullptr;
+        const sz::ZipReader::Entry* entry = nullptr;
+        for (auto&& reader : readers) {
+          if ((entry = reader->find(name))) {
+            from = reader.get();
+            break;
+          }
+        }
+        if (!entry || !writer.add_raw_entry(*from, *entry)) {
+          std::cerr << "cannot copy '" << name << "'" << std::endl;
+          ok = false;
+        }
+      }
+    }
+    ok = writer.close() && ok;
+    readers.clear();
+    std::error_code ec;
+    if (ok) {
+      std::filesystem::rename(tmp_filename, target_filename, ec);
+      ok = !ec;
+    } else {
+      std::filesystem::remove(tmp_filename, ec);
+    }
+
+    auto end = std::chrono::system_clock::now();
+    std::chrono::duration<double> elapsed_seconds = end - start;
+    sz::log::log("Time used: ", std::fixed, std::setprecision(2),
+                 elapsed_seconds.count(), "s");
+
+    std::cerr << "merging zip ... " << (ok ? "success" : "fail") << std::endl;
+    return ok ? 0 : 1;
+  }
+
+  if (section_mb) {
+    options.sync_sections = true;
+    options.section_size = section_mb << 20;
+  }
+
+  if (source_filenames.empty()) {
+    sz::log::panic("no source file to be compressed");
+  }
+
   sz::CompressionMethod compress_method = sz::CompressionMethod::deflate;
   try {
     if (arg_compress_method.empty()) {
@@ -54,23 +290,139 @@ int main(int argc, char** argv) {
 
   if (compress_method == sz::CompressionMethod::deflate) {
     sz::log::log("Deflate: use ", thread_cnt, " thread(s)");
-    sz::log::log("LZ77 level: ", sz::deflate_lz77_level);
+    sz::log::log("LZ77 level: ", options.lz77_level);
+    sz::log::log("ISA: ", sz::cpu::isa_name(sz::cpu::active_isa()));
+  }
+
+  // The sources, their compressed contents and, unless written in parallel,
+  // the archive are all held in memory before the archive is written.
+  if (max_memory_mb && !update_mode && !stream_mode) {
+    sz::uint64 total = 0;
+    for (auto&& source_filename : source_filenames) {
+      std::error_code ec;
+      const auto size = std::filesystem::file_size(source_filename, ec);
+      total += ec ? 0 : size;
+    }
+    if (total * (parallel_write ? 2 : 3) > sz::memory::get_budget()) {
+      sz::log::log("Stream the archive to stay within the memory budget");
+      if (parallel_write) {
+        std::cerr << "--parallel-write is ignored: the archive is streamed to "
+                     "stay within --max-memory"
+                  << std::endl;
+      }
+      stream_mode = true;
+    }
   }
 
   auto start = std::chrono::system_clock::now();
 
+  // With a directory, the compressed contents are reused in every mode.
+  const auto dir_cache =
+      cache_dir.empty() ? nullptr
+                        : std::make_shared<sz::CompressionCache>(cache_dir);
+
+  if (update_mode) {
+    // Entries are copied out of the old archive, so the new one is written
+    // beside it and renamed over it at the end.
+    const std::string tmp_filename = target_filename + ".tmp";
+    auto reader = std::make_unique<sz::ZipReader>(target_filename);
+    sz::ZipWriter writer(tmp_filename);
+    if (!writer.is_open()) {
+      sz::log::panic("cannot write to file '", tmp_filename, "'");
+    }
+    size_t n_reused = 0;
+    for (auto&& source_filename : source_filenames) {
+      if (reader->is_open() &&
+          writer.reuse_entry(*reader, source_filename, compress_method)) {
+        ++n_reused;
+      } else {
+        writer.add_file(source_filename, compress_method, thread_cnt, options,
+                        dir_cache);
+      }
+    }
+    bool ok = writer.close();
+    write_stats(writer.get_stats());
+    reader.reset();
+    std::error_code ec;
+    if (ok) {
+      std::filesystem::rename(tmp_filename, target_filename, ec);
+      ok = !ec;
+    } else {
+      std::filesystem::remove(tmp_filename, ec);
+    }
+
+    auto end = std::chrono::system_clock::now();
+    std::chrono::duration<double> elapsed_seconds = end - start;
+    sz::log::log("Time used: ", std::fixed, std::setprecision(2),
+                 elapsed_seconds.count(), "s");
+    sz::log::log("Reused ", n_reused, " of ", source_filenames.size(),
+                 " entries");
+    if (dir_cache) {
+      sz::log::log("Reused ", dir_cache->n_hits(), " compressed file(s)");
+    }
+    log_memory();
+
+    std::cerr << "updating zip ... " << (ok ? "success" : "fail") << std::endl;
+    return ok ? 0 : 1;
+  }
+
+  if (stream_mode) {
+    sz::ZipWriter writer(target_filename);
+    if (!writer.is_open()) {
+      sz::log::panic("cannot write to file '", target_filename, "'");
+    }
+    for (auto&& source_filename : source_filenames) {
+      writer.add_file(source_filename, compress_method, thread_cnt, options,
+                      dir_cache);
+    }
+    const bool ok = writer.close();
+    write_stats(writer.get_stats());
+    if (dir_cache) {
+      sz::log::log("Reused ", dir_cache->n_hits(), " compressed file(s)");
+    }
+
+    auto end = std::chrono::system_clock::now();
+    std::chrono::duration<double> elapsed_seconds = end - start;
+    sz::log::log("Time used: ", std::fixed, std::setprecision(2),
+                 elapsed_seconds.count(), "s");
+    log_memory();
+
+    std::cerr << "writing zip ... " << (ok ? "success" : "fail") << std::endl;
+    return ok ? 0 : 1;
+  }
+
+  // Without a directory, the cache still compresses duplicate files once.
+  auto cache = dir_cache ? dir_cache : std::make_shared<sz::CompressionCache>();
   sz::Zipper zipper;
   for (auto&& source_filename : source_filenames) {
-    sz::FileEntry file(source_filename, compress_method, thread_cnt);
+    sz::FileEntry file(source_filename, compress_method, thread_cnt, options,
+                       cache);
     file.compress();
     zipper.add_entry(std::move(file));
   }
+  sz::log::log("Reused ", cache->n_hits(), " compressed file(s)");
+  write_stats(zipper.get_stats());
+
+  if (parallel_write) {
+    const bool ok = zipper.write_parallel(target_filename, thread_cnt);
+
+    auto end = std::chrono::system_clock::now();
+    std::chrono::duration<double> elapsed_seconds = end - start;
+    sz::log::log("Time used: ", std::fixed, std::setprecision(2),
+                 elapsed_seconds.count(), "s");
+    log_memory();
+
+    std::cerr << "writing zip ... " << (ok ? "success" : "fail") << std::endl;
+    return ok ? 0 : 1;
+  }
+
   zipper.update_buffer();
 
   auto end = std::chrono::system_clock::now();
   std::chrono::duration<double> elapsed_seconds = end - start;
   sz::log::log("Time used: ", std::fixed, std::setprecision(2),
                elapsed_seconds.count(), "s");
+  log_memory();
 
   std::cerr << "writing zip ... ";
   if (!zipper.write(target_filename)) {
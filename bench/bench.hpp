@@ -0,0 +1,123 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "sz/types.hpp"
+
+namespace sz {
+
+namespace bench {
+
+enum class OutputFormat { text, csv, json };
+
+struct Result {
+  std::string kernel;
+  std::string corpus;
+  // Bytes processed by one run of the kernel.
+  uint64 bytes;
+  size_t runs;
+  // Fastest and median time of one run.
+  double best_seconds;
+  double median_seconds;
+};
+
+// Runs kernels repeatedly and reports their throughput, taken from the
+// fastest run so that noise from the rest of the system is filtered out.
+class Runner {
+ public:
+  Runner(OutputFormat format, std::string filter, double min_seconds,
+         size_t min_runs)
+      : m_format(format),
+        m_filter(std::move(filter)),
+        m_min_seconds(min_seconds),
+        m_min_runs(min_runs) {}
+
+  // Whether the kernel of this name is selected by the filter.
+  [[nodiscard]] bool selected(const std::string& kernel,
+                              const std::string& corpus) const {
+    return m_filter.empty() ||
+           (kernel + "/" + corpus).find(m_filter) != std::string::npos;
+  }
+
+  // Run kernel, which processes bytes bytes per call, until it has run for
+  // min_seconds and min_runs times, after an untimed warm-up run. setup is
+  // called before every run and is not timed.
+  void run(const std::string& kernel, const std::string& corpus,
+           const uint64 bytes, const std::function<void()>& fn,
+           const std::function<void()>& setup = nullptr) {
+    if (!selected(kernel, corpus)) {
+      return;
+    }
+    if (setup) {
+      setup();
+    }
+    fn();
+    std::vector<double> times;
+    double total = 0;
+    while (times.size() < m_min_runs || total < m_min_seconds) {
+      if (setup) {
+        setup();
+      }
+      const auto start = std::chrono::steady_clock::now();
+      fn();
+      const auto end = std::chrono::steady_clock::now();
+      times.push_back(std::chrono::duration<double>(end - start).count());
+      total += times.back();
+    }
+    std::sort(times.begin(), times.end());
+    report(Result{kernel, corpus, bytes, times.size(), times.front(),
+                  times[times.size() / 2]});
+  }
+
+  void begin() {
+    if (m_format == OutputFormat::csv) {
+      printf("kernel,corpus,bytes,runs,best_s,median_s,mb_per_s\n");
+    } else if (m_format == OutputFormat::text) {
+      printf("%-28s %-11s %10s %6s %12s %10s\n", "kernel", "corpus", "bytes",
+             "runs", "best (us)", "MB/s");
+    }
+  }
+
+ private:
+  OutputFormat m_format;
+  std::string m_filter;
+  double m_min_seconds;
+  size_t m_min_runs;
+
+  void report(const Result& r) const {
+    const double mbps = static_cast<double>(r.bytes) / (1 << 20) /
+                        std::max(r.best_seconds, 1e-9);
+    switch (m_format) {
+      case OutputFormat::text:
+        printf("%-28s %-11s %10llu %6zu %12.1f %10.1f\n", r.kernel.c_str(),
+               r.corpus.c_str(), static_cast<unsigned long long>(r.bytes),
+               r.runs, r.best_seconds * 1e6, mbps);
+        break;
+      case OutputFormat::csv:
+        printf("%s,%s,%llu,%zu,%.9f,%.9f,%.3f\n", r.kernel.c_str(),
+               r.corpus.c_str(), static_cast<unsigned long long>(r.bytes),
+               r.runs, r.best_seconds, r.median_seconds, mbps);
+        break;
+      case OutputFormat::json:
+        // One object per line (JSON Lines).
+        printf(
+            "{\"kernel\":\"%s\",\"corpus\":\"%s\",\"bytes\":%llu,"
+            "\"runs\":%zu,\"best_s\":%.9f,\"median_s\":%.9f,"
+            "\"mb_per_s\":%.3f}\n",
+            r.kernel.c_str(), r.corpus.c_str(),
+            static_cast<unsigned long long>(r.bytes), r.runs, r.best_seconds,
+            r.median_seconds, mbps);
+        break;
+    }
+    fflush(stdout);
+  }
+};
+
+}  // namespace bench
+
+}  // namespace sz
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <random>
+#include <string>
+#include <vector>
+
+#include "sz/types.hpp"
+
+namespace sz {
+
+namespace bench {
+
+// Synthetic contents generated locally from a fixed seed, so that every run
+// measures the same bytes.
+enum class CorpusKind { random, text, repetitive, zeros };
+
+constexpr CorpusKind CorpusKinds[] = {CorpusKind::random, CorpusKind::text,
+                                      CorpusKind::repetitive,
+                                      CorpusKind::zeros};
+
+inline const char* corpus_name(const CorpusKind kind) {
+  switch (kind) {
+    case CorpusKind::random:
+      return "random";
+    case CorpusKind::text:
+      return "text";
+    case CorpusKind::repetitive:
+      return "repetitive";
+    case CorpusKind::zeros:
+      return "zeros";
+  }
+  return "";
+}
+
+inline std::vector<Byte> make_corpus(const CorpusKind kind, const size_t n) {
+  std::mt19937 rng(20240229u);
+  std::vector<Byte> res;
+  res.reserve(n);
+  switch (kind) {
+    case CorpusKind::random:
+      while (res.size() < n) {
+        res.push_back(static_cast<Byte>(rng()));
+      }
+      break;
+    case CorpusKind::text: {
+      // Words of a small vocabulary drawn with a skewed distribution, in
+      // lines of varying length.
+      std::vector<std::string> words;
+      for (int i = 0; i < 2000; ++i) {
+        std::string word;
+        const size_t len = 2 + rng() % 9;
+        for (size_t j = 0; j < len; ++j) {
+          word.push_back(static_cast<char>('a' + rng() % 26));
+        }
+        words.push_back(std::move(word));
+      }
+      std::geometric_distribution<size_t> pick(0.01);
+      size_t line = 0;
+      while (res.size() < n) {
+        const std::string& word = words[pick(rng) % words.size()];
+        res.insert(res.end(), word.begin(), word.end());
+        line += word.size() + 1;
+        const bool newline = line > 60 + rng() % 20;
+        res.push_back(newline ? '\n' : ' ');
+        line = newline ? 0 : line;
+      }
+      break;
+    }
+    case CorpusKind::repetitive: {
+      // A random pattern repeated with a mutation now and then.
+      std::vector<Byte> pattern(1024);
+      for (auto& x : pattern) {
+        x = static_cast<Byte>(rng());
+      }
+      while (res.size() < n) {
+        pattern[rng() % pattern.size()] = static_cast<Byte>(rng());
+        res.insert(res.end(), pattern.begin(), pattern.end());
+      }
+      break;
+    }
+    case CorpusKind::zeros:
+      res.resize(n);
+      break;
+  }
+  res.resize(n);
+  return res;
+}
+
+}  // namespace bench
+
+}  // namespace sz
@@ -0,0 +1,159 @@
+// Microbenchmarks of the hot kernels of the compressor, run on synthetic
+// corpora.
+//
+// Usage: sz_bench [--format text|csv|json] [--filter SUBSTR] [--size KB]
+//                 [--min-time SECONDS] [--min-runs N]
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "sz/common.hpp"
+
+#include "bench/bench.hpp"
+#include "bench/corpus.hpp"
+#include "compress/cps_deflate.hpp"
+#include "crc/crc32.hpp"
+#include "util/bit_util.hpp"
+#include "util/progress_bar.hpp"
+
+namespace {
+
+using sz::bench::CorpusKind;
+using sz::bench::Runner;
+
+void usage(const char* argv0) {
+  std::cerr << "Usage: " << argv0
+            << " [--format text|csv|json] [--filter SUBSTR] [--size KB]"
+               " [--min-time SECONDS] [--min-runs N]"
+            << std::endl;
+}
+
+void bench_corpus(Runner& runner, const CorpusKind kind, const size_t size) {
+  const std::string corpus = sz::bench::corpus_name(kind);
+  const std::vector<sz::Byte> src = sz::bench::make_corpus(kind, size);
+  const uint64_t n = src.size();
+
+  runner.run("crc32/extend", corpus, n, [&src] {
+    volatile sz::CRC32Value crc = sz::crc32::extend(0, src.data(), src.size());
+    (void)crc;
+  });
+
+  // The dictionary is large, so it is shared by all levels.
+  auto dict = std::make_shared<sz::LZ77Dictionary>();
+  sz::ProgressBar bar("", &std::cerr, src.size(), 0, ' ', '=', '>');
+  std::vector<sz::LZ77Item> items;
+  std::vector<sz::LZ77Item> level1_items;
+  for (int level = 0; level < static_cast<int>(sz::LZ77DictionaryConfigNum);
+       ++level) {
+    const std::string kernel = "lz77/level" + std::to_string(level);
+    dict->set_level(level);
+    runner.run(kernel, corpus, n, [&] {
+      items.clear();
+      dict->calc(src.data(), src.size(), items, bar);
+    });
+    if (level == 1) {
+      level1_items = items;
+    }
+  }
+  dict->set_level(1);
+  const bool encode = runner.selected("deflate/static_block", corpus) ||
+                      runner.selected("deflate/dynamic_block", corpus);
+  if (encode && level1_items.empty()) {
+    // Filtered out above, but still needed by the encoders.
+    dict->calc(src.data(), src.size(), level1_items, bar);
+  }
+  level1_items.push_back(sz::LZ77Item{sz::LZ77ItemType::eob,
+                                      static_cast<sz::uint16>(
+                                          sz::DeflateEOBCode)});
+
+  runner.run("deflate/static_block", corpus, n, [&level1_items] {
+    auto bs = std::make_shared<sz::BitStream>();
+    sz::deflate_encode_static_block(bs, level1_items, true);
+  });
+  runner.run("deflate/dynamic_block", corpus, n, [&level1_items] {
+    auto bs = std::make_shared<sz::BitStream>();
+    sz::deflate_encode_dynamic_block(bs, level1_items, true);
+  });
+
+  // Symbols in the range of the literal/length alphabet.
+  std::vector<sz::uint64> symbols(src.begin(), src.end());
+  for (size_t i = 0; i < symbols.size(); i += 7) {
+    symbols[i] = 257 + symbols[i] % 29;
+  }
+  sz::HuffmanTree tree(sz::DeflateLELMaxCode + 1, sz::DeflateHuffmanMaxLen);
+  runner.run("huffman/calculate", corpus, n,
+             [&tree, &symbols] { (void)tree.calculate(symbols); });
+
+  // Codes of 1 to 15 bits, their lengths taken from the content.
+  runner.run("bitstream/write_bits", corpus, n, [&src] {
+    sz::BitStream bs(src.size() << 3);
+    for (const sz::Byte x : src) {
+      bs.write_bits(x, (x & 15) | 1);
+    }
+  });
+
+  sz::BitStream whole(src.size() << 3);
+  for (const sz::Byte x : src) {
+    whole.write_bits(x, 8);
+  }
+  std::unique_ptr<sz::BitStream> target;
+  runner.run(
+      "bitstream/append", corpus, n,
+      [&target, &whole] { target->append(whole); },
+      [&target] {
+        // Not on a byte boundary, so every byte is shifted.
+        target = std::make_unique<sz::BitStream>();
+        target->write_bits(5, 3);
+      });
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  sz::bench::OutputFormat format = sz::bench::OutputFormat::text;
+  std::string filter;
+  size_t size = 1 << 20;
+  double min_seconds = 0.2;
+  size_t min_runs = 3;
+  for (int i = 1; i < argc; ++i) {
+    const bool has_value = i + 1 < argc;
+    if (!strcmp(argv[i], "--format") && has_value) {
+      const std::string value = argv[++i];
+      if (value == "csv") {
+        format = sz::bench::OutputFormat::csv;
+      } else if (value == "json") {
+        format = sz::bench::OutputFormat::json;
+      } else if (value != "text") {
+        usage(argv[0]);
+        return 1;
+      }
+    } else if (!strcmp(argv[i], "--filter") && has_value) {
+      filter = argv[++i];
+    } else if (!strcmp(argv[i], "--size") && has_value) {
+      size = static_cast<size_t>(std::strtoull(argv[++i], nullptr, 10)) << 10;
+    } else if (!strcmp(argv[i], "--min-time") && has_value) {
+      min_seconds = std::strtod(argv[++i], nullptr);
+    } else if (!strcmp(argv[i], "--min-runs") && has_value) {
+      min_runs = std::max<size_t>(
+          1, static_cast<size_t>(std::strtoull(argv[++i], nullptr, 10)));
+    } else {
+      usage(argv[0]);
+      return 1;
+    }
+  }
+  if (size == 0) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  Runner runner(format, filter, min_seconds, min_runs);
+  runner.begin();
+  for (const CorpusKind kind : sz::bench::CorpusKinds) {
+    bench_corpus(runner, kind, size);
+  }
+  return 0;
+}
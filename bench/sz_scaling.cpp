@@ -0,0 +1,213 @@
+// End-to-end thread scaling of the deflate compressor, with the time split
+// across its stages.
+//
+// Usage: sz_scaling [--input FILE | --corpus KIND --size MB] [--threads N]
+//                   [--runs N] [--format text|csv|json]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "sz/cpu.hpp"
+
+#include "bench/bench.hpp"
+#include "bench/corpus.hpp"
+#include "compress/cps_deflate.hpp"
+#include "crc/crc32.hpp"
+#include "util/fs.hpp"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double seconds_since(const Clock::time_point start) {
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+struct Run {
+  size_t threads;
+  // End-to-end time: read, crc, compress, concatenate and write.
+  double wall;
+  sz::DeflateStageTimes stages;
+  double crc;
+  double io;
+  uint64_t compressed;
+};
+
+void usage(const char* argv0) {
+  std::cerr << "Usage: " << argv0
+            << " [--input FILE | --corpus random|text|repetitive|zeros"
+               " --size MB] [--threads N] [--runs N]"
+               " [--format text|csv|json]"
+            << std::endl;
+}
+
+// Compress the input once with thread_cnt threads, writing the result to
+// output.
+Run run_once(const std::string& input, const std::vector<sz::Byte>& corpus,
+             const size_t thread_cnt, const std::string& output) {
+  Run run{thread_cnt, 0, {}, 0, 0, 0};
+  const auto start = Clock::now();
+
+  auto stage = Clock::now();
+  const std::vector<sz::Byte> read = input.empty()
+                                         ? std::vector<sz::Byte>()
+                                         : sz::io::read_bytes(input.c_str());
+  const std::vector<sz::Byte>& src = input.empty() ? corpus : read;
+  run.io += seconds_since(stage);
+
+  stage = Clock::now();
+  volatile sz::CRC32Value crc = sz::crc32::calculate(src.data(), src.size());
+  (void)crc;
+  run.crc = seconds_since(stage);
+
+  sz::DeflateCompressor compressor(sz::DeflateCodingType::dynamic_coding,
+                                   thread_cnt);
+  compressor.feed(src.data(), src.size());
+  compressor.compress();
+  std::vector<sz::Byte> dst(compressor.get_length_compressed());
+  compressor.write_result(dst.data());
+  run.stages = compressor.get_stage_times();
+  run.compressed = dst.size();
+
+  stage = Clock::now();
+  FILE* file = sz::io::open_file(output.c_str(), "wb");
+  if (file) {
+    fwrite(dst.data(), 1, dst.size(), file);
+    fclose(file);
+  }
+  run.io += seconds_since(stage);
+
+  run.wall = seconds_since(start);
+  return run;
+}
+
+void report(const sz::bench::OutputFormat format, const Run& r,
+            const double base_wall) {
+  const double speedup = base_wall / r.wall;
+  const double efficiency = speedup / static_cast<double>(r.threads);
+  // Karp-Flatt metric: the serial fraction implied by the speedup.
+  const double p = static_cast<double>(r.threads);
+  const double serial =
+      r.threads > 1 ? (1 / speedup - 1 / p) / (1 - 1 / p) : 0;
+  // Time outside the measured stages, such as the allocation of the
+  // dictionaries, taking the worker stages as perfectly parallel.
+  const double other = r.wall - r.crc - r.io - r.stages.concat -
+                       (r.stages.lz77 + r.stages.encode) / p;
+  switch (format) {
+    case sz::bench::OutputFormat::text:
+      printf(
+          "%7zu %9.3f %7.2f %6.1f%% %7.3f %9.3f %9.3f %9.3f %8.3f %8.3f "
+          "%8.3f\n",
+          r.threads, r.wall, speedup, efficiency * 100, serial, r.stages.lz77,
+          r.stages.encode, r.stages.concat, r.crc, r.io, other);
+      break;
+    case sz::bench::OutputFormat::csv:
+      printf("%zu,%.6f,%.4f,%.4f,%.4f,%.6f,%.6f,%.6f,%.6f,%.6f,%.6f,%llu\n",
+             r.threads, r.wall, speedup, efficiency, serial, r.stages.lz77,
+             r.stages.encode, r.stages.concat, r.crc, r.io, other,
+             static_cast<unsigned long long>(r.compressed));
+      break;
+    case sz::bench::OutputFormat::json:
+      printf(
+          "{\"threads\":%zu,\"wall_s\":%.6f,\"speedup\":%.4f,"
+          "\"efficiency\":%.4f,\"serial_fraction\":%.4f,\"lz77_s\":%.6f,"
+          "\"encode_s\":%.6f,\"concat_s\":%.6f,\"crc_s\":%.6f,\"io_s\":%.6f,"
+          "\"other_s\":%.6f,\"compressed\":%llu}\n",
+          r.threads, r.wall, speedup, efficiency, serial, r.stages.lz77,
+          r.stages.encode, r.stages.concat, r.crc, r.io, other,
+          static_cast<unsigned long long>(r.compressed));
+      break;
+  }
+  fflush(stdout);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  sz::bench::OutputFormat format = sz::bench::OutputFormat::text;
+  std::string input;
+  sz::bench::CorpusKind kind = sz::bench::CorpusKind::text;
+  size_t size = 8 << 20;
+  size_t max_threads = sz::cpu::available_cpus();
+  size_t runs = 1;
+  for (int i = 1; i < argc; ++i) {
+    const bool has_value = i + 1 < argc;
+    if (!strcmp(argv[i], "--format") && has_value) {
+      const std::string value = argv[++i];
+      if (value == "csv") {
+        format = sz::bench::OutputFormat::csv;
+      } else if (value == "json") {
+        format = sz::bench::OutputFormat::json;
+      } else if (value != "text") {
+        usage(argv[0]);
+        return 1;
+      }
+    } else if (!strcmp(argv[i], "--input") && has_value) {
+      input = argv[++i];
+    } else if (!strcmp(argv[i], "--corpus") && has_value) {
+      const std::string value = argv[++i];
+      bool found = false;
+      for (const auto k : sz::bench::CorpusKinds) {
+        if (value == sz::bench::corpus_name(k)) {
+          kind = k;
+          found = true;
+        }
+      }
+      if (!found) {
+        usage(argv[0]);
+        return 1;
+      }
+    } else if (!strcmp(argv[i], "--size") && has_value) {
+      size = static_cast<size_t>(std::strtoull(argv[++i], nullptr, 10)) << 20;
+    } else if (!strcmp(argv[i], "--threads") && has_value) {
+      max_threads = static_cast<size_t>(std::strtoull(argv[++i], nullptr, 10));
+    } else if (!strcmp(argv[i], "--runs") && has_value) {
+      runs = static_cast<size_t>(std::strtoull(argv[++i], nullptr, 10));
+    } else {
+      usage(argv[0]);
+      return 1;
+    }
+  }
+  if (max_threads == 0 || runs == 0 || (input.empty() && size == 0)) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  const std::vector<sz::Byte> corpus =
+      input.empty() ? sz::bench::make_corpus(kind, size)
+                    : std::vector<sz::Byte>();
+  const std::string output = "sz_scaling.out";
+
+  if (format == sz::bench::OutputFormat::csv) {
+    printf(
+        "threads,wall_s,speedup,efficiency,serial_fraction,lz77_s,encode_s,"
+        "concat_s,crc_s,io_s,other_s,compressed\n");
+  } else if (format == sz::bench::OutputFormat::text) {
+    // Stage times of the work threads are summed over the threads.
+    printf("%7s %9s %7s %7s %7s %9s %9s %9s %8s %8s %8s\n", "threads",
+           "wall (s)", "speedup", "eff", "serial", "lz77", "encode", "concat",
+           "crc", "io", "other");
+  }
+  double base_wall = 0;
+  for (size_t t = 1; t <= max_threads; ++t) {
+    Run best{};
+    for (size_t i = 0; i < runs; ++i) {
+      const Run run = run_once(input, corpus, t, output);
+      if (i == 0 || run.wall < best.wall) {
+        best = run;
+      }
+    }
+    if (t == 1) {
+      base_wall = best.wall;
+    }
+    report(format, best, base_wall);
+  }
+  std::remove(output.c_str());
+  return 0;
+}
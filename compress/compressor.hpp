@@ -1,14 +1,18 @@
 #pragma once
 
 #include <cstring>
+#include <utility>
 
 #include "sz/types.hpp"
 
+#include "util/byte_util.hpp"
+
 namespace sz {
 
 class Compressor {
  public:
-  Compressor() : m_src(nullptr), m_src_len(0), m_finish(false) {}
+  Compressor()
+      : m_src(nullptr), m_src_len(0), m_finish(false), m_stream_len(0) {}
 
   Compressor(const Compressor&) = delete;
   Compressor& operator=(const Compressor&) = delete;
@@ -38,6 +42,28 @@ class Compressor {
   // Call compress() first if the compression has not been called.
   virtual void write_result(Byte* dst) = 0;
 
+  // Pass the compressed content to sink, possibly in several pieces.
+  // Call compress() first if the compression has not been called.
+  virtual void write_result(const ByteSink& sink) = 0;
+
+  // Streaming interface: begin() -> push() ... push() -> finish().
+  // The content is compressed chunk by chunk, and the compressed content is
+  // passed to sink as soon as it is produced. Only the in-flight part of the
+  // content is kept in memory.
+
+  // Start a new stream whose compressed content goes to sink.
+  virtual void begin(ByteSink sink) {
+    m_sink = std::move(sink);
+    m_stream_len = 0;
+  }
+
+  // Push the next chunk of content to be compressed.
+  virtual void push(const Byte* data, size_t n) = 0;
+
+  // Compress the rest of the content and close the stream.
+  // Return the total length of compressed content of the stream.
+  virtual size_t finish() = 0;
+
  protected:
   // Source content to be compressed.
   Byte* m_src;
@@ -46,6 +72,19 @@ class Compressor {
   // Whether the compressed data has been calculated.
   // Unset when fed by new data, set when compress() is called and finished.
   bool m_finish;
+
+  // Receiver of the compressed content of the stream.
+  ByteSink m_sink;
+  // Length of compressed content passed to the sink.
+  size_t m_stream_len;
+
+  // Pass a piece of compressed content to the sink.
+  void emit(const Byte* data, size_t n) {
+    if (n) {
+      m_sink(data, n);
+      m_stream_len += n;
+    }
+  }
 };
 
 }  // namespace sz
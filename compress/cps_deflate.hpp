@@ -1,7 +1,14 @@
 #pragma once
 
+#include <algorithm>
 #include <array>
+#include <atomic>
+#include <memory>
+#include <vector>
 
+#include "sz/common.hpp"
+#include "sz/memory.hpp"
+#include "sz/stats.hpp"
 #include "sz/types.hpp"
 
 #include "compress/compressor.hpp"
@@ -48,10 +55,32 @@ constexpr size_t LZ77DictionaryConfig[LZ77DictionaryConfigNum][4]{
     {4096, 258, 258, 258},
 };
 
-size_t lz77_get_config(const size_t level);
+// Maximum number of sections recorded for a stream. Beyond it, adjacent
+// sections are merged. The index of this many sections still fits in an
+// extra field.
+constexpr size_t DeflateMaxSections = 4000;
 
 enum class DeflateCodingType { static_coding, dynamic_coding };
 
+// A part of a deflate stream that starts on a byte boundary and can be
+// inflated without the content before it.
+struct DeflateSection {
+  uint64 compressed_len;
+  uint64 uncompressed_len;
+};
+
+// Seconds spent in each stage of a deflate compressor, summed over its work
+// threads.
+struct DeflateStageTimes {
+  // LZ77 dictionary matching.
+  double lz77;
+  // Huffman coding of the LZ77 items into bit streams.
+  double encode;
+  // Concatenation of the blocks into the output, including the time spent in
+  // the sink.
+  double concat;
+};
+
 enum class LZ77ItemType { literal, distance, length, eob };
 
 struct LZ77Item {
@@ -59,8 +88,22 @@ struct LZ77Item {
   uint16 val;
 };
 
-void deflate_encode_store_block(const std::shared_ptr<BitStream>& bs,
-                                const Byte* src, size_t n, bool last_block);
+// Store blocks are aligned to byte, so they are written at their final
+// position in the output.
+void deflate_encode_store_block(BitStreamWriter& out, const Byte* src,
+                                size_t n, bool last_block);
+
+// Return the number of bits of store blocks of n bytes, if they are written
+// at bit offset off.
+uint64 deflate_store_block_bits(uint64 off, size_t n);
+
+// Write an empty non-final store block, which brings the output to a byte
+// boundary without ending the stream (a sync flush).
+void deflate_encode_sync_block(BitStreamWriter& out);
+
+// Return the number of bits of a sync block, if it is written at bit offset
+// off.
+uint64 deflate_sync_block_bits(uint64 off);
 
 void deflate_encode_static_block(const std::shared_ptr<BitStream>& bs,
                                  const std::vector<LZ77Item>& items,
@@ -76,10 +119,14 @@ std::vector<uint32> run_length_encode(const std::vector<int>& src);
 
 std::pair<int, int> run_length_decode(uint32 code);
 
+class LZ77Dictionary;
+
 class DeflateCompressor final : public Compressor {
  public:
   DeflateCompressor(DeflateCodingType coding_type);
   DeflateCompressor(DeflateCodingType coding_type, size_t thread_cnt);
+  // Take the coding type, sections, LZ77 level and pinning from options.
+  DeflateCompressor(const CompressionOptions& options, size_t thread_cnt);
   DeflateCompressor(const DeflateCompressor&) = delete;
   DeflateCompressor& operator=(const DeflateCompressor&) = delete;
   DeflateCompressor(DeflateCompressor&&) = delete;
@@ -90,16 +137,140 @@ class DeflateCompressor final : public Compressor {
 
   [[nodiscard]] size_t get_length_compressed() const override;
   void write_result(Byte* dst) override;
+  void write_result(const ByteSink& sink) override;
+
+  void begin(ByteSink sink) override;
+  void push(const Byte* data, size_t n) override;
+  size_t finish() override;
+
+  // End every block with a sync block, so that the blocks, which do not refer
+  // to each other, can be inflated in parallel. Their extents are recorded
+  // as sections.
+  void set_sync_sections(bool sync) { m_sync_sections = sync; }
+
+  // Make each section hold at least size bytes of content, that is, a whole
+  // number of blocks. Smaller sections give finer random access, and larger
+  // ones a smaller index.
+  void set_section_size(size_t size) {
+    m_min_section_blocks =
+        std::max<size_t>(1, (size + DeflateBlockSize - 1) / DeflateBlockSize);
+  }
+
+  // Sections of the compressed content, available after compress() or
+  // finish() if set_sync_sections() is set.
+  [[nodiscard]] const std::vector<DeflateSection>& get_sections() const {
+    return m_sections;
+  }
+
+  // Content pushed into the stream but not compressed yet, which is at most a
+  // block per stream worker and one more byte.
+  [[nodiscard]] size_t get_pending_size() const { return m_pending.size(); }
+
+  // Blocks compressed at a time by the stream since begin().
+  [[nodiscard]] size_t get_stream_workers() const { return m_stream_workers; }
+
+  // Time spent in each stage by the last compress(), or by the stream since
+  // begin(), including write_result().
+  [[nodiscard]] DeflateStageTimes get_stage_times() const;
+
+  // Estimated peak bytes used by a worker: its dictionary, its LZ77 items and
+  // its encoded block.
+  [[nodiscard]] static uint64 worker_memory();
+
+  // Statistics of the blocks of the compressed content, in stream order,
+  // available after compress() or finish().
+  [[nodiscard]] const std::vector<BlockStats>& get_block_stats() const {
+    return m_block_stats;
+  }
 
  private:
   // Coding type: static / dynamic
   DeflateCodingType m_coding_type;
   // Thread count.
   size_t m_thread_cnt;
-  // Compressed content.
-  Byte* m_res;
+  // Level of the LZ77 dictionaries.
+  int m_lz77_level;
+  // Whether the workers are pinned to CPUs.
+  bool m_pin_workers;
+  // Whether blocks end with a sync block.
+  bool m_sync_sections;
+  // Sections of the compressed content.
+  std::vector<DeflateSection> m_sections;
+  // Byte offset of the end of the last closed section.
+  uint64 m_section_end;
+  // Blocks per section set by set_section_size().
+  size_t m_min_section_blocks;
+  // Blocks per section, doubled whenever the sections are merged.
+  size_t m_section_blocks;
+  // Blocks in the open section.
+  size_t m_open_blocks;
+  // Uncompressed length of the open section.
+  uint64 m_open_len;
+
+  struct Block {
+    // Source content of the block.
+    const Byte* src;
+    size_t len;
+    bool last;
+    // Encoded bits, or nullptr for a store block.
+    std::shared_ptr<BitStream> bs;
+    BlockStats stats;
+    // Bytes of the encoded bits.
+    memory::Charge charge{memory::Use::encoded};
+  };
+  // Compressed blocks of the fed content.
+  std::vector<Block> m_blocks;
   // Size of compressed content.
   size_t m_res_len;
+
+  // Content pushed into the stream but not compressed yet.
+  std::vector<Byte> m_pending;
+  memory::Charge m_pending_charge;
+  // Blocks compressed at a time by the stream, within the memory budget.
+  size_t m_stream_workers;
+  // Output of the stream.
+  std::shared_ptr<BitStreamWriter> m_out;
+  // Dictionaries of the stream workers, created by the workers and reused
+  // among batches.
+  std::vector<std::shared_ptr<LZ77Dictionary>> m_dicts;
+
+  // Nanoseconds spent in each stage, added to by the work threads.
+  mutable std::atomic<uint64> m_lz77_ns;
+  mutable std::atomic<uint64> m_encode_ns;
+  std::atomic<uint64> m_concat_ns;
+
+  // Statistics of the blocks written so far.
+  std::vector<BlockStats> m_block_stats;
+
+  void reset_stage_times();
+
+  // Run LZ77 on [p, q) and return the encoded block, recording its
+  // statistics except for the output length in stats.
+  // Return nullptr if it is not smaller than a store block.
+  std::shared_ptr<BitStream> encode_block(LZ77Dictionary& dict,
+                                          std::vector<LZ77Item>& items,
+                                          const Byte* p, const Byte* q,
+                                          bool last_block, ProgressBar& bar,
+                                          BlockStats& stats) const;
+
+  // Record the statistics of the block, which starts at bit offset off of
+  // the output.
+  void add_block_stats(const Block& block, uint64 off);
+
+  // Write the block to out, followed by a sync block if sections are
+  // recorded and it is not the last block.
+  void write_block(const Block& block, BitStreamWriter& out) const;
+
+  void reset_sections();
+
+  // Account for a block of len bytes that ends at bit offset end, right
+  // after its sync block if any. The open section is closed if it is full
+  // or the block is the last one.
+  void add_section_block(uint64 end, size_t len, bool last);
+
+  // Compress the first n bytes of pending content in parallel, one block per
+  // worker, and pass the complete bytes to the sink.
+  void stream_blocks(size_t n, bool last);
 };
 
 constexpr size_t HashBufferSize = LZ77DictionarySize + DeflateRepeatLenMax;
@@ -108,32 +279,67 @@ constexpr size_t Hash3bHeadSize = 257 * 257 * 257;
 
 class LZ77Dictionary final {
  public:
-  LZ77Dictionary() : m_head3b(), m_hash(), m_left(0) {}
+  LZ77Dictionary() : LZ77Dictionary(CompressionOptions().lz77_level) {}
+  explicit LZ77Dictionary(int level)
+      : m_head3b(),
+        m_hash(),
+        m_left(0),
+        m_chain_steps(0),
+        m_level(0),
+        m_charge(memory::Use::lz77, sizeof(LZ77Dictionary)) {
+    set_level(level);
+  }
 
   LZ77Dictionary(const LZ77Dictionary&) = delete;
   LZ77Dictionary& operator=(const LZ77Dictionary&) = delete;
   LZ77Dictionary(LZ77Dictionary&&) = delete;
   LZ77Dictionary& operator=(LZ77Dictionary&&) = delete;
-  ~LZ77Dictionary() = default;
+  ~LZ77Dictionary() { release(); }
 
   void calc(const Byte* src, size_t n, std::vector<LZ77Item>& res,
             ProgressBar& bar);
 
+  // Use the LZ77DictionaryConfig of level for the following calc().
+  void set_level(int level);
+
+  // Number of hash chain candidates compared by the last calc().
+  [[nodiscard]] uint64 get_chain_steps() const { return m_chain_steps; }
+
+  // Bytes used by a dictionary after calc() on n bytes.
+  [[nodiscard]] static uint64 memory_use(size_t n) {
+    return sizeof(LZ77Dictionary) + static_cast<uint64>(n) * NodeAllocSize;
+  }
+
  private:
   struct LLNode {
     LLNode* next;
     size_t pos;
   };
+  // Heap bytes taken by a node, whose allocation is rounded up with its
+  // header to twice its size.
+  static constexpr size_t NodeAllocSize = 2 * sizeof(LLNode);
 
   std::array<LLNode*, Hash3bHeadSize> m_head3b;
   std::array<uint64, HashBufferSize> m_hash;
   size_t m_left;
+  uint64 m_chain_steps;
+  int m_level;
+  memory::Charge m_charge;
+
+  // calc() with the LZ77DictionaryConfig of Level, whose thresholds are
+  // constants of the match loop.
+  template <size_t Level>
+  void calc_level(const Byte* src, size_t n, std::vector<LZ77Item>& res,
+                  ProgressBar& bar);
 
   // Get hash value of sequence of length n started from pos.
   [[nodiscard]] uint64 get_hash(size_t pos, size_t n) const;
 
   void reset();
 
+  // Free all linked list nodes.
+  void release();
+
   // Return the uint16 hash value of 3 bytes.
   // -1 for out of bound.
   static uint32 get_hash3b(int a, int b, int c) {
@@ -22,6 +22,19 @@ class StoreCompressor final : public Compressor {
   void write_result(Byte* dst) override {
     memcpy(dst, m_src, sizeof(Byte) * m_src_len);
   }
+
+  void write_result(const ByteSink& sink) override {
+    if (m_src_len) {
+      sink(m_src, m_src_len);
+    }
+  }
+
+  void push(const Byte* data, size_t n) override { emit(data, n); }
+
+  size_t finish() override {
+    m_sink = nullptr;
+    return m_stream_len;
+  }
 };
 
 }  // namespace sz
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <utility>
+
+#include "sz/types.hpp"
+
+namespace sz {
+
+class Decompressor {
+ public:
+  Decompressor() : m_stream_len(0) {}
+
+  Decompressor(const Decompressor&) = delete;
+  Decompressor& operator=(const Decompressor&) = delete;
+  Decompressor(Decompressor&&) = delete;
+  Decompressor& operator=(Decompressor&&) = delete;
+
+  virtual ~Decompressor() = default;
+
+  // Decompress n bytes of src into dst, whose length dst_len must be the
+  // exact length of the decompressed content.
+  // Return false if the content is corrupted or its length is not dst_len.
+  [[nodiscard]] virtual bool decompress(const Byte* src, size_t n, Byte* dst,
+                                        size_t dst_len) = 0;
+
+  // Streaming interface: begin() -> push() ... push() -> finish().
+  // The compressed content is pushed chunk by chunk, and the decompressed
+  // content is passed to sink as soon as it is produced.
+
+  // Start a new stream whose decompressed content goes to sink.
+  virtual void begin(ByteSink sink) {
+    m_sink = std::move(sink);
+    m_stream_len = 0;
+  }
+
+  // Push the next chunk of compressed content.
+  // Return false if the content is found corrupted.
+  [[nodiscard]] virtual bool push(const Byte* data, size_t n) = 0;
+
+  // Decompress the rest of the content and close the stream.
+  // Return false if the content is corrupted or incomplete.
+  [[nodiscard]] virtual bool finish() = 0;
+
+  // Length of decompressed content passed to the sink so far.
+  [[nodiscard]] size_t get_length_decompressed() const {
+    return m_stream_len;
+  }
+
+ protected:
+  // Receiver of the decompressed content of the stream.
+  ByteSink m_sink;
+  // Length of decompressed content passed to the sink.
+  size_t m_stream_len;
+
+  // Pass a piece of decompressed content to the sink.
+  void emit(const Byte* data, size_t n) {
+    if (n) {
+      m_sink(data, n);
+      m_stream_len += n;
+    }
+  }
+};
+
+}  // namespace sz
@@ -1,30 +1,76 @@
-#include <cassert>
+#include <algorithm>
+#include <chrono>
 #include <iomanip>
 #include <thread>
 
+#include "sz/cpu.hpp"
 #include "sz/log.hpp"
+#include "sz/trace.hpp"
 
 #include "compress/cps_deflate.hpp"
 #include "compress/table_deflate.hpp"
 
 namespace sz {
 
+namespace {
+
+// Statistics of the block of empty content.
+BlockStats empty_block_stats() {
+  return BlockStats{BlockType::static_coding, 0, 0, 0, 0, 0, 0, 0, 0};
+}
+
+uint64 now_ns() {
+  return static_cast<uint64>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now().time_since_epoch())
+          .count());
+}
+
+}  // namespace
+
 DeflateCompressor::DeflateCompressor(DeflateCodingType coding_type)
-    : DeflateCompressor(coding_type, std::thread::hardware_concurrency()) {}
+    : DeflateCompressor(coding_type, cpu::available_cpus()) {}
 
 DeflateCompressor::DeflateCompressor(DeflateCodingType coding_type,
                                      size_t thread_cnt)
     : m_coding_type(coding_type),
       m_thread_cnt(thread_cnt),
-      m_res(nullptr),
-      m_res_len(0) {}
+      m_lz77_level(CompressionOptions().lz77_level),
+      m_pin_workers(false),
+      m_sync_sections(false),
+      m_section_end(0),
+      m_min_section_blocks(1),
+      m_section_blocks(1),
+      m_open_blocks(0),
+      m_open_len(0),
+      m_res_len(0),
+      m_pending_charge(memory::Use::source),
+      m_stream_workers(1),
+      m_lz77_ns(0),
+      m_encode_ns(0),
+      m_concat_ns(0) {}
+
+DeflateCompressor::DeflateCompressor(const CompressionOptions& options,
+                                     size_t thread_cnt)
+    : DeflateCompressor(options.use_static ? DeflateCodingType::static_coding
+                                           : DeflateCodingType::dynamic_coding,
+                        thread_cnt) {
+  m_lz77_level = options.lz77_level;
+  m_pin_workers = options.pin_workers;
+  set_sync_sections(options.sync_sections);
+  set_section_size(options.section_size);
+}
 
 size_t DeflateCompressor::compress() {
   if (m_finish) {
     return get_length_compressed();
   }
-  delete[] m_res;
+  trace::Span span("deflate::compress", m_src_len);
+  m_blocks.clear();
   m_res_len = 0;
+  reset_sections();
+  reset_stage_times();
+  m_block_stats.clear();
 
   log::log("File size: ", std::setprecision(2), std::fixed,
            static_cast<float>(m_src_len) / 1024.f, " KB");
@@ -34,92 +80,86 @@ size_t DeflateCompressor::compress() {
                   '>');
   bar.set_display(true);
 
-  // The work thread that runs LZ77 on [st, ed) and encodes the result.
-  auto work_thread = [this](const Byte* st, const Byte* ed,
-                            const bool last_section,
-                            std::shared_ptr<BitStream>& bs, ProgressBar& bar) {
-    bs = std::make_shared<BitStream>((ed - st) << 3);
+  // Split the content into blocks. A tail shorter than a block is merged into
+  // the previous block.
+  for (size_t off = 0, len; off < m_src_len; off += len) {
+    len = std::min(DeflateBlockSize, m_src_len - off);
+    if (m_src_len - off - len < DeflateBlockSize) {
+      len = m_src_len - off;
+    }
+    m_blocks.push_back(Block{m_src + off, len, off + len == m_src_len, nullptr,
+                             BlockStats{}});
+  }
+
+  // The work thread that runs LZ77 on blocks [st, ed) and encodes them.
+  // Its buffers are allocated after it is pinned, so that they are local to
+  // its CPU.
+  auto work_thread = [this](const size_t worker, const size_t st,
+                            const size_t ed, ProgressBar& bar) {
+    if (m_pin_workers) {
+      (void)cpu::pin_thread(worker);
+    }
     // LZ77 dictionary.
-    auto dict = std::make_shared<LZ77Dictionary>();
+    auto dict = std::make_shared<LZ77Dictionary>(m_lz77_level);
     // The vector that stores LZ77's result. Though the input bytes is actually
     // O(2 * DeflateBlockSize), it is not necessary to reserve that many.
     std::vector<LZ77Item> items;
     items.reserve(DeflateBlockSize);
+    memory::Charge items_charge(memory::Use::lz77,
+                                items.capacity() * sizeof(LZ77Item));
 
-    for (const Byte *p = st, *q; p < ed; p = q) {
-      q = p + DeflateBlockSize <= ed ? p + DeflateBlockSize : ed;
-      if (static_cast<size_t>(ed - q) < DeflateBlockSize) {
-        q = ed;
-      }
-      const bool last_block = q == ed && last_section;
-
-      // Run LZ77 to obtain the deflate items.
-      // auto start = std::chrono::system_clock::now();
-      items.clear();
-      dict->calc(p, q - p, items, bar);
-      // auto end = std::chrono::system_clock::now();
-      // std::chrono::duration<double> elapsed_seconds = end - start;
-      // std::cerr << "elapsed time (" << std::this_thread::get_id()
-      //           << "): " << elapsed_seconds.count() << " for " << q - p
-      //           << "bytes: " << p - m_src << " ~ " << q - m_src << std::endl;
-      items.push_back(LZ77Item{LZ77ItemType::eob, DeflateEOBCode});
-
-      // Encode the deflate items into bit stream.
-      // The size of the bit stream is then compared to the one of a store
-      // block. The better one is adopted.
-      auto bs_cps = std::make_shared<BitStream>(items.size() << 3);
-      switch (m_coding_type) {
-        case DeflateCodingType::static_coding:
-          deflate_encode_static_block(bs_cps, items, last_block);
-          break;
-        case DeflateCodingType::dynamic_coding:
-          deflate_encode_dynamic_block(bs_cps, items, last_block);
-          break;
-      }
-
-      if (bs_cps->get_bytes_size() >= static_cast<size_t>(q - p)) {
-        // Use store.
-        deflate_encode_store_block(bs, p, q - p, last_block);
-        // log::log(bs_cps->get_bytes_size(), "(deflate) v.s. ", q - p,
-        //          "(original), use store");
-      } else {
-        // Use static/dynamic coding.
-        bs->append(*bs_cps);
-        // log::log(bs_cps->get_bytes_size(), "(deflate) v.s. ", q - p,
-        //          "(original), use deflate");
-      }
+    for (size_t i = st; i < ed; ++i) {
+      Block& block = m_blocks[i];
+      trace::Span block_span("deflate::block", block.len);
+      block.bs = encode_block(*dict, items, block.src, block.src + block.len,
+                              block.last, bar, block.stats);
+      items_charge.set(items.capacity() * sizeof(LZ77Item));
+      block.charge.set(block.bs ? block.bs->get_bytes_size() : 0);
     }
   };
 
-  // Parallelism scheduler.
-  const int block_cnt =
-      static_cast<int>((m_src_len + DeflateBlockSize - 1) / DeflateBlockSize);
-  const int thread_cnt = std::min(block_cnt, static_cast<int>(m_thread_cnt));
-  const int each_cnt = (block_cnt + thread_cnt - 1) / thread_cnt;
-  std::vector<std::shared_ptr<BitStream>> bss(thread_cnt);
-  std::vector<std::shared_ptr<std::thread>> threads(thread_cnt);
-  const Byte* p = m_src;
-  const Byte* ed = m_src + m_src_len;
-  for (int i = 0; i < thread_cnt; ++i) {
-    const Byte* q = std::min(p + each_cnt * DeflateBlockSize, ed);
-    threads[i] = std::make_shared<std::thread>(work_thread, p, q, q == ed,
-                                               std::ref(bss[i]), std::ref(bar));
-    p = q;
-  }
-  for (int i = 0; i < thread_cnt; ++i) {
-    threads[i]->join();
+  // Parallelism scheduler. Each worker holds a dictionary, so fewer of them
+  // run if the memory budget is short.
+  const size_t block_cnt = m_blocks.size();
+  const size_t fit_cnt = memory::fit_workers(m_thread_cnt, worker_memory());
+  if (fit_cnt < m_thread_cnt) {
+    log::log("Deflate: use ", fit_cnt, " thread(s) within the memory budget");
+  }
+  const size_t thread_cnt = std::min(block_cnt, fit_cnt);
+  if (thread_cnt > 0) {
+    const size_t each_cnt = (block_cnt + thread_cnt - 1) / thread_cnt;
+    std::vector<std::shared_ptr<std::thread>> threads;
+    for (size_t i = 0; i < block_cnt; i += each_cnt) {
+      threads.push_back(std::make_shared<std::thread>(
+          work_thread, threads.size(), i, std::min(i + each_cnt, block_cnt),
+          std::ref(bar)));
+    }
+    for (auto&& thread : threads) {
+      thread->join();
+    }
+  } else {
+    // Empty content: a final static block with end-of-block only.
+    auto bs = std::make_shared<BitStream>();
+    deflate_encode_static_block(
+        bs, {LZ77Item{LZ77ItemType::eob, DeflateEOBCode}}, true);
+    m_blocks.push_back(Block{m_src, 0, true, bs, empty_block_stats()});
   }
   bar.set_full();
   bar.set_display(false);
 
-  auto bs = std::make_shared<BitStream>(m_src_len << 3);
-  for (int i = 0; i < thread_cnt; ++i) {
-    bs->append(*bss[i]);
+  // The blocks are concatenated only when written. Here only the length is
+  // counted, taking the alignment of store and sync blocks into account.
+  uint64 bits = 0;
+  for (const auto& block : m_blocks) {
+    add_block_stats(block, bits);
+    bits += block.bs ? block.bs->get_bits_size()
+                     : deflate_store_block_bits(bits, block.len);
+    if (m_sync_sections && !block.last) {
+      bits += deflate_sync_block_bits(bits);
+    }
+    add_section_block(bits, block.len, block.last);
   }
-
-  m_res_len = bs->get_bytes_size();
-  m_res = new Byte[m_res_len];
-  bs->export_bitstream(m_res);
+  m_res_len = static_cast<size_t>((bits + 7) >> 3);
   m_finish = true;
 
   log::log("Compressed size: ", std::setprecision(2), std::fixed,
@@ -135,36 +175,322 @@ size_t DeflateCompressor::compress() {
 size_t DeflateCompressor::get_length_compressed() const { return m_res_len; }
 
 void DeflateCompressor::write_result(Byte* dst) {
-  memcpy(dst, m_res, sizeof(Byte) * m_res_len);
+  write_result([&dst](const Byte* data, size_t n) {
+    memcpy(dst, data, sizeof(Byte) * n);
+    dst += n;
+  });
+}
+
+void DeflateCompressor::write_result(const ByteSink& sink) {
+  trace::Span span("deflate::concat");
+  const uint64 start = now_ns();
+  BitStreamWriter out(sink);
+  for (const auto& block : m_blocks) {
+    write_block(block, out);
+  }
+  out.flush();
+  m_concat_ns += now_ns() - start;
+}
+
+DeflateStageTimes DeflateCompressor::get_stage_times() const {
+  return DeflateStageTimes{static_cast<double>(m_lz77_ns) * 1e-9,
+                           static_cast<double>(m_encode_ns) * 1e-9,
+                           static_cast<double>(m_concat_ns) * 1e-9};
+}
+
+void DeflateCompressor::reset_stage_times() {
+  m_lz77_ns = 0;
+  m_encode_ns = 0;
+  m_concat_ns = 0;
+}
+
+uint64 DeflateCompressor::worker_memory() {
+  // A block is at most twice the block size, when the tail is merged into it.
+  constexpr size_t MaxBlockSize = 2 * DeflateBlockSize;
+  return LZ77Dictionary::memory_use(MaxBlockSize) +
+         MaxBlockSize * sizeof(LZ77Item) + MaxBlockSize;
+}
+
+void DeflateCompressor::begin(ByteSink sink) {
+  Compressor::begin(std::move(sink));
+  m_pending.clear();
+  m_stream_workers = memory::fit_workers(m_thread_cnt, worker_memory());
+  if (m_stream_workers < m_thread_cnt) {
+    log::log("Deflate: use ", m_stream_workers,
+             " thread(s) within the memory budget");
+  }
+  reset_sections();
+  reset_stage_times();
+  m_block_stats.clear();
+  m_out = std::make_shared<BitStreamWriter>(
+      [this](const Byte* data, size_t n) { emit(data, n); });
+}
+
+void DeflateCompressor::push(const Byte* data, size_t n) {
+  // At most one batch (a block per worker) is kept pending. A batch is
+  // compressed only when more content follows it, so that the last block can
+  // be marked in finish().
+  const size_t batch = m_stream_workers * DeflateBlockSize;
+  while (n > 0) {
+    const size_t take = std::min(n, batch + 1 - m_pending.size());
+    m_pending.insert(m_pending.end(), data, data + take);
+    m_pending_charge.set(m_pending.capacity());
+    data += take;
+    n -= take;
+    if (m_pending.size() > batch) {
+      stream_blocks(batch, false);
+    }
+  }
+}
+
+size_t DeflateCompressor::finish() {
+  if (m_pending.empty()) {
+    // Empty content: a final static block with end-of-block only.
+    auto bs = std::make_shared<BitStream>();
+    deflate_encode_static_block(
+        bs, {LZ77Item{LZ77ItemType::eob, DeflateEOBCode}}, true);
+    add_block_stats(Block{nullptr, 0, true, bs, empty_block_stats()},
+                    m_out->get_bits_size());
+    m_out->append(*bs);
+    add_section_block(m_out->get_bits_size(), 0, true);
+  } else {
+    stream_blocks(m_pending.size(), true);
+  }
+  m_out->flush();
+
+  m_out.reset();
+  m_dicts.clear();
+  m_pending.clear();
+  m_pending.shrink_to_fit();
+  m_pending_charge.set(0);
+  m_sink = nullptr;
+
+  log::log("Compressed size: ", std::setprecision(2), std::fixed,
+           static_cast<float>(m_stream_len) / 1024.f, " KB");
+  return m_stream_len;
+}
+
+std::shared_ptr<BitStream> DeflateCompressor::encode_block(
+    LZ77Dictionary& dict, std::vector<LZ77Item>& items, const Byte* p,
+    const Byte* q, const bool last_block, ProgressBar& bar,
+    BlockStats& stats) const {
+  // Run LZ77 to obtain the deflate items.
+  const uint64 start = now_ns();
+  trace::Span lz77_span("deflate::lz77", static_cast<uint64>(q - p));
+  items.clear();
+  dict.calc(p, q - p, items, bar);
+  items.push_back(LZ77Item{LZ77ItemType::eob, DeflateEOBCode});
+  lz77_span.end();
+  const uint64 lz77_end = now_ns();
+  m_lz77_ns += lz77_end - start;
+
+  stats = BlockStats{m_coding_type == DeflateCodingType::static_coding
+                         ? BlockType::static_coding
+                         : BlockType::dynamic_coding,
+                     static_cast<uint64>(q - p),
+                     0,
+                     0,
+                     0,
+                     0,
+                     dict.get_chain_steps(),
+                     static_cast<double>(lz77_end - start) * 1e-9,
+                     0};
+  for (const auto& item : items) {
+    if (item.type == LZ77ItemType::literal) {
+      ++stats.n_literals;
+    } else if (item.type == LZ77ItemType::length) {
+      ++stats.n_matches;
+      stats.match_bytes += item.val;
+    }
+  }
+
+  // Encode the deflate items into bit stream.
+  // The size of the bit stream is then compared to the one of a store
+  // block. The better one is adopted.
+  trace::Span encode_span("deflate::encode", static_cast<uint64>(q - p));
+  auto bs = std::make_shared<BitStream>(items.size() << 3);
+  switch (m_coding_type) {
+    case DeflateCodingType::static_coding:
+      deflate_encode_static_block(bs, items, last_block);
+      break;
+    case DeflateCodingType::dynamic_coding:
+      deflate_encode_dynamic_block(bs, items, last_block);
+      break;
+  }
+  encode_span.end();
+  const uint64 encode_end = now_ns();
+  m_encode_ns += encode_end - lz77_end;
+  stats.encode_seconds = static_cast<double>(encode_end - lz77_end) * 1e-9;
+  if (bs->get_bytes_size() >= static_cast<size_t>(q - p)) {
+    return nullptr;
+  }
+  return bs;
 }
 
-size_t lz77_get_config(const size_t level) {
-  if (static_cast<size_t>(deflate_lz77_level) >= LZ77DictionaryConfigNum) {
-    log::panic("Unrecognized LZ77 level: ", level);
+void DeflateCompressor::write_block(const Block& block,
+                                    BitStreamWriter& out) const {
+  if (block.bs) {
+    out.append(*block.bs);
+  } else {
+    deflate_encode_store_block(out, block.src, block.len, block.last);
   }
-  assert(level < 4);
-  return LZ77DictionaryConfig[deflate_lz77_level][level];
+  if (m_sync_sections && !block.last) {
+    deflate_encode_sync_block(out);
+  }
+}
+
+void DeflateCompressor::add_block_stats(const Block& block, const uint64 off) {
+  BlockStats stats = block.stats;
+  if (block.bs) {
+    stats.output_bits = block.bs->get_bits_size();
+  } else {
+    stats.type = BlockType::store;
+    stats.output_bits = deflate_store_block_bits(off, block.len);
+  }
+  m_block_stats.push_back(stats);
+}
+
+void DeflateCompressor::reset_sections() {
+  m_sections.clear();
+  m_section_end = 0;
+  m_section_blocks = m_min_section_blocks;
+  m_open_blocks = 0;
+  m_open_len = 0;
 }
 
-void deflate_encode_store_block(const std::shared_ptr<BitStream>& bs,
-                                const Byte* src, const size_t n,
-                                const bool last_block) {
+void DeflateCompressor::add_section_block(const uint64 end, const size_t len,
+                                          const bool last) {
+  if (!m_sync_sections) {
+    return;
+  }
+  m_open_len += len;
+  if (++m_open_blocks < m_section_blocks && !last) {
+    return;
+  }
+  const uint64 end_byte = (end + 7) >> 3;
+  m_sections.push_back(DeflateSection{end_byte - m_section_end, m_open_len});
+  m_section_end = end_byte;
+  m_open_blocks = 0;
+  m_open_len = 0;
+
+  // Too many sections: merge adjacent pairs, and make the following sections
+  // twice as long.
+  if (m_sections.size() > DeflateMaxSections) {
+    size_t k = 0;
+    for (size_t i = 0; i < m_sections.size(); i += 2, ++k) {
+      m_sections[k] = m_sections[i];
+      if (i + 1 < m_sections.size()) {
+        m_sections[k].compressed_len += m_sections[i + 1].compressed_len;
+        m_sections[k].uncompressed_len += m_sections[i + 1].uncompressed_len;
+      }
+    }
+    m_sections.resize(k);
+    m_section_blocks <<= 1;
+  }
+}
+
+void DeflateCompressor::stream_blocks(const size_t n, const bool last) {
+  trace::Span span("deflate::stream_blocks", n);
+  const size_t block_cnt = (n + DeflateBlockSize - 1) / DeflateBlockSize;
+  if (m_dicts.size() < block_cnt) {
+    m_dicts.resize(block_cnt);
+  }
+
+  // The stream length is unknown, so the progress is not displayed.
+  ProgressBar bar(std::string("deflate: "), &std::cerr, n, 30, ' ', '=', '>');
+
+  std::vector<Block> blocks(block_cnt);
+  // A worker creates its dictionary the first time, after it is pinned, so
+  // that the dictionary is local to the CPU it keeps running on.
+  auto work_thread = [this](const size_t worker, Block& block,
+                            std::shared_ptr<LZ77Dictionary>& dict,
+                            ProgressBar& bar) {
+    if (m_pin_workers) {
+      (void)cpu::pin_thread(worker);
+    }
+    if (!dict) {
+      dict = std::make_shared<LZ77Dictionary>(m_lz77_level);
+    }
+    trace::Span block_span("deflate::block", block.len);
+    std::vector<LZ77Item> items;
+    items.reserve(block.len);
+    memory::Charge items_charge(memory::Use::lz77,
+                                items.capacity() * sizeof(LZ77Item));
+    block.bs = encode_block(*dict, items, block.src, block.src + block.len,
+                            block.last, bar, block.stats);
+    items_charge.set(items.capacity() * sizeof(LZ77Item));
+    block.charge.set(block.bs ? block.bs->get_bytes_size() : 0);
+  };
+
+  std::vector<std::shared_ptr<std::thread>> threads(block_cnt);
+  for (size_t i = 0; i < block_cnt; ++i) {
+    const size_t off = i * DeflateBlockSize;
+    const size_t len = std::min(DeflateBlockSize, n - off);
+    blocks[i] = Block{&m_pending[off], len, last && off + len == n, nullptr,
+                      BlockStats{}};
+    threads[i] = std::make_shared<std::thread>(
+        work_thread, i, std::ref(blocks[i]), std::ref(m_dicts[i]),
+        std::ref(bar));
+  }
+  for (size_t i = 0; i < block_cnt; ++i) {
+    threads[i]->join();
+  }
+
+  // Blocks are not byte aligned. Only complete bytes leave the stream, the
+  // trailing bits wait for the next block.
+  const uint64 start = now_ns();
+  for (auto&& block : blocks) {
+    add_block_stats(block, m_out->get_bits_size());
+    write_block(block, *m_out);
+    add_section_block(m_out->get_bits_size(), block.len, block.last);
+    block.bs.reset();
+    block.charge.set(0);
+  }
+  m_concat_ns += now_ns() - start;
+  m_pending.erase(m_pending.begin(), m_pending.begin() + n);
+}
+
+void deflate_encode_store_block(BitStreamWriter& out, const Byte* src,
+                                const size_t n, const bool last_block) {
   size_t rest = n;
   while (rest > 0) {
     constexpr size_t SubBlockSize = (1 << 16) - 1;
     const size_t sub_block = std::min(SubBlockSize, rest);
-    bs->write_bit(last_block && sub_block == rest);
-    bs->write_bits(0b00, 2);
-    bs->align_to_byte(0);
-    bs->write_bits(static_cast<uint16>(sub_block), 16);
-    bs->write_bits(static_cast<uint16>(~sub_block), 16);
-    for (const Byte* q = src + sub_block; src < q; ++src) {
-      bs->write_bits(*src, 8);
-    }
+    out.write_bits(last_block && sub_block == rest, 1);
+    out.write_bits(0b00, 2);
+    out.align_to_byte();
+    out.write_bits(static_cast<uint16>(sub_block), 16);
+    out.write_bits(static_cast<uint16>(~sub_block), 16);
+    out.write_bytes(src, sub_block);
+    src += sub_block;
     rest -= sub_block;
   }
 }
 
+uint64 deflate_store_block_bits(const uint64 off, const size_t n) {
+  uint64 bits = off;
+  size_t rest = n;
+  while (rest > 0) {
+    constexpr size_t SubBlockSize = (1 << 16) - 1;
+    const size_t sub_block = std::min(SubBlockSize, rest);
+    bits = ((bits + 3 + 7) & ~7ull) + 32 + (static_cast<uint64>(sub_block) << 3);
+    rest -= sub_block;
+  }
+  return bits - off;
+}
+
+void deflate_encode_sync_block(BitStreamWriter& out) {
+  out.write_bits(0, 1);
+  out.write_bits(0b00, 2);
+  out.align_to_byte();
+  out.write_bits(0x0000, 16);
+  out.write_bits(0xFFFF, 16);
+}
+
+uint64 deflate_sync_block_bits(const uint64 off) {
+  return ((off + 3 + 7) & ~7ull) + 32 - off;
+}
+
 void deflate_encode_static_block(const std::shared_ptr<BitStream>& bs,
                                  const std::vector<LZ77Item>& items,
                                  const bool last_block) {
@@ -244,6 +570,7 @@ void deflate_encode_dynamic_block(const std::shared_ptr<BitStream>& bs,
   }
 
   // Calculate run length code, build 3 Huffman trees.
+  trace::Span huffman_span("deflate::huffman");
   HuffmanTree h1(DeflateLELMaxCode + 1, DeflateHuffmanMaxLen);
   HuffmanTree h2(DeflateDisMaxCode + 1, DeflateHuffmanMaxLen);
   HuffmanTree h3(DeflateRLCMaxCode + 1, DeflateRLCMaxLen);
@@ -260,6 +587,7 @@ void deflate_encode_dynamic_block(const std::shared_ptr<BitStream>& bs,
   }
   auto cl3 =
       h3.calculate(std::vector<uint64>(rlc_combine.begin(), rlc_combine.end()));
+  huffman_span.end();
 
   // Encode into bit stream.
   // header
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <vector>
+
+#include "sz/types.hpp"
+
+#include "compress/decompressor.hpp"
+
+namespace sz {
+
+// A table-driven decoder of a canonical huffman code.
+// A code of at most primary bits is resolved by a single lookup of the next
+// primary bits of the input. A longer code leads to a subtable, which is
+// indexed by the bits following the primary bits.
+class HuffmanDecodeTable final {
+ public:
+  struct Entry {
+    // Literal, base of length / distance, or start of the subtable.
+    uint16 value;
+    // Number of bits to consume.
+    uint8 len;
+    // Kind of the entry. For length / distance, the number of extra bits.
+    uint8 tag;
+  };
+
+  static constexpr uint8 TagLiteral = 0x80;
+  static constexpr uint8 TagEnd = 0x40;
+  // Low bits give the number of index bits of the subtable.
+  static constexpr uint8 TagSubtable = 0x20;
+  static constexpr uint8 TagInvalid = 0x10;
+  static constexpr uint8 TagExtraMask = 0x0F;
+
+  HuffmanDecodeTable() : m_primary_bits(0) {}
+
+  // Build the table from the code lengths of n symbols. The value and the tag
+  // of symbol i are taken from symbols[i].
+  // Return false if the code lengths are over-subscribed. Bits not covered by
+  // an incomplete code decode to an invalid entry.
+  [[nodiscard]] bool build(const uint8* lens, int n, const Entry* symbols,
+                           int primary_bits);
+
+  [[nodiscard]] const Entry* data() const { return m_entries.data(); }
+  [[nodiscard]] int primary_bits() const { return m_primary_bits; }
+
+ private:
+  std::vector<Entry> m_entries;
+  int m_primary_bits;
+};
+
+class InflateDecoder final : public Decompressor {
+ public:
+  InflateDecoder();
+  InflateDecoder(const InflateDecoder&) = delete;
+  InflateDecoder& operator=(const InflateDecoder&) = delete;
+  InflateDecoder(InflateDecoder&&) = delete;
+  InflateDecoder& operator=(InflateDecoder&&) = delete;
+  ~InflateDecoder() override = default;
+
+  bool decompress(const Byte* src, size_t n, Byte* dst,
+                  size_t dst_len) override;
+
+  // Decompress a section of a deflate stream (see DeflateSection) of n bytes
+  // into dst of exactly dst_len bytes. The section must end with the final
+  // block if last is set, and on a block boundary at the end of src
+  // otherwise.
+  [[nodiscard]] bool decompress_section(const Byte* src, size_t n, Byte* dst,
+                                        size_t dst_len, bool last);
+
+  // Decompress the blocks of a section of n bytes into dst of dst_len bytes
+  // until at least need bytes are decoded, for a read that does not need the
+  // rest of the section. Return false if the content is corrupted or ends
+  // before need bytes.
+  [[nodiscard]] bool decompress_prefix(const Byte* src, size_t n, Byte* dst,
+                                       size_t dst_len, size_t need);
+
+  void begin(ByteSink sink) override;
+  bool push(const Byte* data, size_t n) override;
+  bool finish() override;
+
+ private:
+  // Tables of the current dynamic block.
+  HuffmanDecodeTable m_litlen;
+  HuffmanDecodeTable m_distance;
+  HuffmanDecodeTable m_precode;
+
+  // The stream is resumed at block granularity: a block is decoded once all
+  // of its input has arrived, and decoded again from its start otherwise.
+
+  // Compressed content pushed but not decoded yet.
+  std::vector<Byte> m_in;
+  // Bit offset of the next block in the first byte of m_in.
+  int m_in_bit;
+  // Do not retry decoding before m_in grows to this length.
+  size_t m_retry_len;
+  // The last 32 KBytes of decompressed content followed by the output of the
+  // current block.
+  std::vector<Byte> m_window;
+  // Length of the decompressed content kept in m_window.
+  size_t m_window_len;
+  // Space reserved in m_window for the output of a block.
+  size_t m_out_reserve;
+  // Whether the last block has been decoded.
+  bool m_done;
+  // Whether the stream is found corrupted.
+  bool m_failed;
+
+  // Decode as many complete blocks of m_in as possible.
+  // If flush is set, the input is complete and a partial block is an error.
+  // Return false if the content is corrupted.
+  bool decode_stream(bool flush);
+};
+
+}  // namespace sz
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstring>
+
+#include "compress/decompressor.hpp"
+
+namespace sz {
+
+class StoreDecoder final : public Decompressor {
+ public:
+  StoreDecoder() = default;
+  StoreDecoder(const StoreDecoder&) = delete;
+  StoreDecoder& operator=(const StoreDecoder&) = delete;
+  StoreDecoder(StoreDecoder&&) = delete;
+  StoreDecoder& operator=(StoreDecoder&&) = delete;
+  ~StoreDecoder() override = default;
+
+  bool decompress(const Byte* src, size_t n, Byte* dst,
+                  size_t dst_len) override {
+    if (n != dst_len) {
+      return false;
+    }
+    if (n) {
+      memcpy(dst, src, sizeof(Byte) * n);
+    }
+    return true;
+  }
+
+  bool push(const Byte* data, size_t n) override {
+    emit(data, n);
+    return true;
+  }
+
+  bool finish() override {
+    m_sink = nullptr;
+    return true;
+  }
+};
+
+}  // namespace sz
@@ -0,0 +1,647 @@
+#include "compress/dps_inflate.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#include "compress/cps_deflate.hpp"
+#include "util/bit_util.hpp"
+
+namespace sz {
+
+namespace {
+
+using Entry = HuffmanDecodeTable::Entry;
+
+constexpr int InflateLitLenSymbolNum = 288;
+constexpr int InflateDistanceSymbolNum = 32;
+constexpr int InflateRLCSymbolNum = DeflateRLCMaxCode + 1;
+
+// Largest HLIT and HDIST allowed in a dynamic block header.
+constexpr int InflateHLITMax = DeflateLELMaxCode + 1;
+constexpr int InflateHDISTMax = DeflateDisMaxCode + 1;
+
+// Number of bits resolved by the first lookup of each table.
+constexpr int InflateLitLenPrimaryBits = 10;
+constexpr int InflateDistancePrimaryBits = 8;
+constexpr int InflateRLCPrimaryBits = DeflateRLCMaxLen;
+
+// Initial space reserved for the output of a block when streaming.
+constexpr size_t InflateOutReserve = 256 << 10;
+
+constexpr uint16 InflateLengthBase[] = {3,  4,  5,  6,   7,   8,   9,   10,
+                                        11, 13, 15, 17,  19,  23,  27,  31,
+                                        35, 43, 51, 59,  67,  83,  99,  115,
+                                        131, 163, 195, 227, 258};
+constexpr uint8 InflateLengthExtra[] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1,
+                                        1, 1, 2, 2, 2, 2, 3, 3, 3, 3,
+                                        4, 4, 4, 4, 5, 5, 5, 5, 0};
+constexpr uint16 InflateDistanceBase[] = {
+    1,    2,    3,    4,    5,    7,     9,     13,    17,  25,
+    33,   49,   65,   97,   129,  193,   257,   385,   513, 769,
+    1025, 1537, 2049, 3073, 4097, 6145,  8193,  12289, 16385, 24577};
+constexpr uint8 InflateDistanceExtra[] = {0, 0, 0,  0,  1,  1,  2,  2,
+                                          3, 3, 4,  4,  5,  5,  6,  6,
+                                          7, 7, 8,  8,  9,  9,  10, 10,
+                                          11, 11, 12, 12, 13, 13};
+
+// Value and tag of every symbol of the three alphabets.
+struct InflateSymbols {
+  Entry litlen[InflateLitLenSymbolNum];
+  Entry distance[InflateDistanceSymbolNum];
+  Entry rlc[InflateRLCSymbolNum];
+
+  InflateSymbols() : litlen(), distance(), rlc() {
+    for (int i = 0; i < InflateLitLenSymbolNum; ++i) {
+      if (i < DeflateEOBCode) {
+        litlen[i] = {static_cast<uint16>(i), 0, HuffmanDecodeTable::TagLiteral};
+      } else if (i == DeflateEOBCode) {
+        litlen[i] = {0, 0, HuffmanDecodeTable::TagEnd};
+      } else if (i <= DeflateLELMaxCode) {
+        const int k = i - DeflateEOBCode - 1;
+        litlen[i] = {InflateLengthBase[k], 0, InflateLengthExtra[k]};
+      } else {
+        litlen[i] = {0, 0, HuffmanDecodeTable::TagInvalid};
+      }
+    }
+    for (int i = 0; i < InflateDistanceSymbolNum; ++i) {
+      if (i <= DeflateDisMaxCode) {
+        distance[i] = {InflateDistanceBase[i], 0, InflateDistanceExtra[i]};
+      } else {
+        distance[i] = {0, 0, HuffmanDecodeTable::TagInvalid};
+      }
+    }
+    for (int i = 0; i < InflateRLCSymbolNum; ++i) {
+      rlc[i] = {static_cast<uint16>(i), 0, HuffmanDecodeTable::TagLiteral};
+    }
+  }
+};
+
+const InflateSymbols& get_symbols() {
+  static const InflateSymbols symbols;
+  return symbols;
+}
+
+// Tables of the static coding.
+struct InflateStaticTables {
+  HuffmanDecodeTable litlen;
+  HuffmanDecodeTable distance;
+
+  InflateStaticTables() {
+    uint8 lens[InflateLitLenSymbolNum];
+    std::fill(lens, lens + 144, 8);
+    std::fill(lens + 144, lens + 256, 9);
+    std::fill(lens + 256, lens + 280, 7);
+    std::fill(lens + 280, lens + InflateLitLenSymbolNum, 8);
+    (void)litlen.build(lens, InflateLitLenSymbolNum, get_symbols().litlen,
+                       InflateLitLenPrimaryBits);
+    std::fill(lens, lens + InflateDistanceSymbolNum, 5);
+    (void)distance.build(lens, InflateDistanceSymbolNum,
+                         get_symbols().distance, InflateDistancePrimaryBits);
+  }
+};
+
+const InflateStaticTables& get_static_tables() {
+  static const InflateStaticTables tables;
+  return tables;
+}
+
+inline uint64 load_64(const Byte* p) {
+  uint64 x;
+  memcpy(&x, p, sizeof(x));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  x = __builtin_bswap64(x);
+#endif
+  return x;
+}
+
+// Reader of the bits of [begin, end), least significant bit first.
+// Bits are loaded into a 64-bit buffer, which holds at least 56 bits after a
+// refill. Bits past the end read as 0, and the caller finds out by
+// overrun_consumed() whether any of them has been consumed.
+class BitReader {
+ public:
+  BitReader(const Byte* begin, const Byte* end, int skip_bits)
+      : m_begin(begin), m_p(begin), m_end(end), m_buf(0), m_cnt(0),
+        m_overrun(0) {
+    refill();
+    consume(skip_bits);
+  }
+
+  void refill() {
+    if (m_end - m_p >= 8) {
+      // Load 8 bytes at once, but only count the whole bytes that fit.
+      m_buf |= load_64(m_p) << m_cnt;
+      m_p += (63 - m_cnt) >> 3;
+      m_cnt |= 56;
+    } else {
+      while (m_cnt <= 56) {
+        if (m_p != m_end) {
+          m_buf |= static_cast<uint64>(*m_p++) << m_cnt;
+        } else {
+          ++m_overrun;
+        }
+        m_cnt += 8;
+      }
+    }
+  }
+
+  [[nodiscard]] uint64 peek() const { return m_buf; }
+
+  void consume(int n) {
+    m_buf >>= n;
+    m_cnt -= n;
+  }
+
+  // Read n (<= 32) bits.
+  uint32 bits(int n) {
+    const auto x = static_cast<uint32>(m_buf & ((1ull << n) - 1));
+    consume(n);
+    return x;
+  }
+
+  [[nodiscard]] bool overrun() const { return m_overrun != 0; }
+
+  // Whether any bit past the end has been consumed.
+  [[nodiscard]] bool overrun_consumed() const {
+    return m_overrun * 8 > static_cast<size_t>(m_cnt);
+  }
+
+  // Drop the bits up to the next byte boundary and empty the buffer, so that
+  // the following bytes can be read by bytes().
+  // Return false if the bits past the end have been consumed.
+  bool align_to_byte() {
+    consume(m_cnt & 7);
+    const size_t buffered = static_cast<size_t>(m_cnt) >> 3;
+    if (m_overrun > buffered) {
+      return false;
+    }
+    m_p -= buffered - m_overrun;
+    m_buf = 0;
+    m_cnt = 0;
+    m_overrun = 0;
+    return true;
+  }
+
+  // Number of bytes available after align_to_byte().
+  [[nodiscard]] size_t bytes_left() const {
+    return static_cast<size_t>(m_end - m_p);
+  }
+
+  // Take n bytes after align_to_byte().
+  const Byte* bytes(size_t n) {
+    const Byte* p = m_p;
+    m_p += n;
+    return p;
+  }
+
+  // Position of the next bit to consume, counted from begin.
+  [[nodiscard]] uint64 position() const {
+    return static_cast<uint64>(m_p - m_begin + m_overrun) * 8 - m_cnt;
+  }
+
+ private:
+  const Byte* m_begin;
+  const Byte* m_p;
+  const Byte* m_end;
+  uint64 m_buf;
+  int m_cnt;
+  size_t m_overrun;
+};
+
+enum class InflateStatus { ok, need_input, need_output, error };
+
+// Report status, unless the bits past the end have been consumed, in which
+// case the status is the result of reading zeros in place of missing input.
+inline InflateStatus check(const BitReader& in, InflateStatus status) {
+  return in.overrun_consumed() ? InflateStatus::need_input : status;
+}
+
+inline Entry decode_symbol(BitReader& in, const HuffmanDecodeTable& table) {
+  const Entry* entries = table.data();
+  const int primary_bits = table.primary_bits();
+  Entry e = entries[in.peek() & ((1u << primary_bits) - 1)];
+  if (e.tag & HuffmanDecodeTable::TagSubtable) {
+    in.consume(primary_bits);
+    const int sub_bits = e.tag & HuffmanDecodeTable::TagExtraMask;
+    e = entries[e.value + (in.peek() & ((1u << sub_bits) - 1))];
+  }
+  in.consume(e.len);
+  return e;
+}
+
+// Copy len bytes from dist bytes before out.
+inline void copy_match(Byte* out, size_t dist, size_t len, const Byte* end) {
+  const Byte* src = out - dist;
+  if (dist >= 8 && static_cast<size_t>(end - out) >= len + 7) {
+    // Words of 8 bytes do not overlap their source, and the last word may
+    // write past len, into the space that is not decoded yet.
+    Byte* dst = out;
+    const Byte* dst_end = out + len;
+    do {
+      memcpy(dst, src, 8);
+      dst += 8;
+      src += 8;
+    } while (dst < dst_end);
+  } else if (dist == 1) {
+    memset(out, *src, len);
+  } else {
+    for (size_t i = 0; i < len; ++i) {
+      out[i] = src[i];
+    }
+  }
+}
+
+InflateStatus read_dynamic_header(BitReader& in, HuffmanDecodeTable& litlen,
+                                  HuffmanDecodeTable& distance,
+                                  HuffmanDecodeTable& precode) {
+  const InflateSymbols& symbols = get_symbols();
+
+  in.refill();
+  const int hlit = static_cast<int>(in.bits(5)) + DeflateHLITMin;
+  const int hdist = static_cast<int>(in.bits(5)) + DeflateHDISTMin;
+  const int hclen = static_cast<int>(in.bits(4)) + DeflateHCLENMin;
+  if (hlit > InflateHLITMax || hdist > InflateHDISTMax) {
+    return check(in, InflateStatus::error);
+  }
+
+  uint8 rlc_lens[InflateRLCSymbolNum] = {};
+  for (int i = 0; i < hclen; ++i) {
+    in.refill();
+    rlc_lens[DeflateRLCPermutation[i]] = static_cast<uint8>(in.bits(3));
+  }
+  if (!precode.build(rlc_lens, InflateRLCSymbolNum, symbols.rlc,
+                     InflateRLCPrimaryBits)) {
+    return check(in, InflateStatus::error);
+  }
+
+  uint8 lens[InflateHLITMax + InflateHDISTMax] = {};
+  const int total = hlit + hdist;
+  for (int i = 0; i < total;) {
+    in.refill();
+    const Entry e = decode_symbol(in, precode);
+    if (e.tag & HuffmanDecodeTable::TagInvalid) {
+      return check(in, InflateStatus::error);
+    }
+    if (e.value < 16) {
+      lens[i++] = static_cast<uint8>(e.value);
+      continue;
+    }
+    uint8 val = 0;
+    int rep = 0;
+    if (e.value == 16) {
+      if (i == 0) {
+        return check(in, InflateStatus::error);
+      }
+      val = lens[i - 1];
+      rep = 3 + static_cast<int>(in.bits(2));
+    } else if (e.value == 17) {
+      rep = 3 + static_cast<int>(in.bits(3));
+    } else {
+      rep = 11 + static_cast<int>(in.bits(7));
+    }
+    if (i + rep > total) {
+      return check(in, InflateStatus::error);
+    }
+    std::fill(lens + i, lens + i + rep, val);
+    i += rep;
+  }
+  if (lens[DeflateEOBCode] == 0) {
+    return check(in, InflateStatus::error);
+  }
+
+  if (!litlen.build(lens, hlit, symbols.litlen, InflateLitLenPrimaryBits) ||
+      !distance.build(lens + hlit, hdist, symbols.distance,
+                      InflateDistancePrimaryBits)) {
+    return check(in, InflateStatus::error);
+  }
+  return check(in, InflateStatus::ok);
+}
+
+InflateStatus decode_huffman_block(BitReader& in,
+                                   const HuffmanDecodeTable& litlen,
+                                   const HuffmanDecodeTable& distance,
+                                   const Byte* out_begin, Byte*& out,
+                                   Byte* out_end) {
+  Byte* o = out;
+  while (true) {
+    // A refill covers a length with its extra bits (15 + 5) and a distance
+    // with its extra bits (15 + 13).
+    in.refill();
+    if (in.overrun() && in.overrun_consumed()) {
+      return InflateStatus::need_input;
+    }
+
+    const Entry e = decode_symbol(in, litlen);
+    if (e.tag & HuffmanDecodeTable::TagLiteral) {
+      if (o == out_end) {
+        return check(in, InflateStatus::need_output);
+      }
+      *o++ = static_cast<Byte>(e.value);
+      continue;
+    }
+    if (e.tag & HuffmanDecodeTable::TagEnd) {
+      break;
+    }
+    if (e.tag & HuffmanDecodeTable::TagInvalid) {
+      return check(in, InflateStatus::error);
+    }
+    const size_t len = e.value + in.bits(e.tag);
+
+    const Entry d = decode_symbol(in, distance);
+    if (d.tag & HuffmanDecodeTable::TagInvalid) {
+      return check(in, InflateStatus::error);
+    }
+    const size_t dist = d.value + in.bits(d.tag);
+    if (dist > static_cast<size_t>(o - out_begin)) {
+      return check(in, InflateStatus::error);
+    }
+    if (len > static_cast<size_t>(out_end - o)) {
+      return check(in, InflateStatus::need_output);
+    }
+    copy_match(o, dist, len, out_end);
+    o += len;
+  }
+  if (in.overrun_consumed()) {
+    return InflateStatus::need_input;
+  }
+  out = o;
+  return InflateStatus::ok;
+}
+
+InflateStatus decode_store_block(BitReader& in, Byte*& out, Byte* out_end) {
+  if (!in.align_to_byte() || in.bytes_left() < 4) {
+    return InflateStatus::need_input;
+  }
+  const Byte* p = in.bytes(4);
+  const size_t len = p[0] | p[1] << 8;
+  const size_t nlen = p[2] | p[3] << 8;
+  if ((len ^ nlen) != 0xFFFF) {
+    return InflateStatus::error;
+  }
+  if (in.bytes_left() < len) {
+    return InflateStatus::need_input;
+  }
+  if (static_cast<size_t>(out_end - out) < len) {
+    return InflateStatus::need_output;
+  }
+  if (len) {
+    memcpy(out, in.bytes(len), len);
+    out += len;
+  }
+  return InflateStatus::ok;
+}
+
+// Decode a block from in, writing to out. out_begin is the start of the
+// decoded content that distances may refer to.
+// out is advanced only if the block is decoded.
+InflateStatus decode_block(BitReader& in, const Byte* out_begin, Byte*& out,
+                           Byte* out_end, bool& last,
+                           HuffmanDecodeTable& litlen,
+                           HuffmanDecodeTable& distance,
+                           HuffmanDecodeTable& precode) {
+  in.refill();
+  last = in.bits(1);
+  const uint32 type = in.bits(2);
+  switch (type) {
+    case 0:
+      return decode_store_block(in, out, out_end);
+    case 1: {
+      const InflateStaticTables& tables = get_static_tables();
+      return decode_huffman_block(in, tables.litlen, tables.distance,
+                                  out_begin, out, out_end);
+    }
+    case 2: {
+      const InflateStatus status =
+          read_dynamic_header(in, litlen, distance, precode);
+      if (status != InflateStatus::ok) {
+        return status;
+      }
+      return decode_huffman_block(in, litlen, distance, out_begin, out,
+                                  out_end);
+    }
+    default:
+      return check(in, InflateStatus::error);
+  }
+}
+
+}  // namespace
+
+bool HuffmanDecodeTable::build(const uint8* lens, const int n,
+                               const Entry* symbols, const int primary_bits) {
+  int count[DeflateHuffmanMaxLen + 1] = {};
+  for (int i = 0; i < n; ++i) {
+    ++count[lens[i]];
+  }
+  count[0] = 0;
+  int left = 1;
+  for (int len = 1; len <= DeflateHuffmanMaxLen; ++len) {
+    left = (left << 1) - count[len];
+    if (left < 0) {
+      return false;
+    }
+  }
+
+  uint32 next_code[DeflateHuffmanMaxLen + 1] = {};
+  for (int len = 1; len <= DeflateHuffmanMaxLen; ++len) {
+    next_code[len] = (next_code[len - 1] + count[len - 1]) << 1;
+  }
+
+  m_primary_bits = primary_bits;
+  const uint32 primary_size = 1u << primary_bits;
+  const Entry invalid{0, 0, TagInvalid};
+  m_entries.assign(primary_size, invalid);
+
+  // Codes are read from the least significant bit, so the tables are indexed
+  // by the reversed codes.
+  std::vector<uint32> codes(n);
+  std::vector<uint8> sub_bits(primary_size, 0);
+  for (int i = 0; i < n; ++i) {
+    const int len = lens[i];
+    if (len == 0) {
+      continue;
+    }
+    codes[i] = static_cast<uint32>(reverse_bits(next_code[len]++, len));
+    if (len <= primary_bits) {
+      for (uint32 k = codes[i]; k < primary_size; k += 1u << len) {
+        m_entries[k] = {symbols[i].value, static_cast<uint8>(len),
+                        symbols[i].tag};
+      }
+    } else {
+      uint8& bits = sub_bits[codes[i] & (primary_size - 1)];
+      bits = std::max(bits, static_cast<uint8>(len - primary_bits));
+    }
+  }
+
+  // Each primary index shared by longer codes owns a subtable large enough
+  // for the longest of them.
+  for (uint32 k = 0; k < primary_size; ++k) {
+    if (sub_bits[k]) {
+      m_entries[k] = {static_cast<uint16>(m_entries.size()),
+                      static_cast<uint8>(primary_bits),
+                      static_cast<uint8>(TagSubtable | sub_bits[k])};
+      const size_t sub_size = static_cast<size_t>(1) << sub_bits[k];
+      m_entries.resize(m_entries.size() + sub_size, invalid);
+    }
+  }
+  for (int i = 0; i < n; ++i) {
+    const int len = lens[i];
+    if (len <= primary_bits) {
+      continue;
+    }
+    const Entry& link = m_entries[codes[i] & (primary_size - 1)];
+    const uint32 sub_size = 1u << (link.tag & TagExtraMask);
+    const int sub_len = len - primary_bits;
+    for (uint32 k = codes[i] >> primary_bits; k < sub_size;
+         k += 1u << sub_len) {
+      m_entries[link.value + k] = {symbols[i].value,
+                                   static_cast<uint8>(sub_len), symbols[i].tag};
+    }
+  }
+  return true;
+}
+
+InflateDecoder::InflateDecoder()
+    : m_in_bit(0),
+      m_retry_len(0),
+      m_window_len(0),
+      m_out_reserve(InflateOutReserve),
+      m_done(false),
+      m_failed(false) {}
+
+bool InflateDecoder::decompress(const Byte* src, const size_t n, Byte* dst,
+                                const size_t dst_len) {
+  BitReader in(src, src + n, 0);
+  Byte* out = dst;
+  Byte* out_end = dst + dst_len;
+  bool last = false;
+  while (!last) {
+    if (decode_block(in, dst, out, out_end, last, m_litlen, m_distance,
+                     m_precode) != InflateStatus::ok) {
+      return false;
+    }
+  }
+  return out == out_end;
+}
+
+bool InflateDecoder::decompress_section(const Byte* src, const size_t n,
+                                        Byte* dst, const size_t dst_len,
+                                        const bool last) {
+  BitReader in(src, src + n, 0);
+  Byte* out = dst;
+  Byte* out_end = dst + dst_len;
+  const uint64 end = static_cast<uint64>(n) * 8;
+  bool final_block = false;
+  while (!final_block && in.position() < end) {
+    if (decode_block(in, dst, out, out_end, final_block, m_litlen, m_distance,
+                     m_precode) != InflateStatus::ok) {
+      return false;
+    }
+  }
+  if (final_block != last || (!last && in.position() != end)) {
+    return false;
+  }
+  return out == out_end;
+}
+
+bool InflateDecoder::decompress_prefix(const Byte* src, const size_t n,
+                                       Byte* dst, const size_t dst_len,
+                                       const size_t need) {
+  BitReader in(src, src + n, 0);
+  Byte* out = dst;
+  Byte* out_end = dst + dst_len;
+  const uint64 end = static_cast<uint64>(n) * 8;
+  bool final_block = false;
+  while (static_cast<size_t>(out - dst) < need) {
+    if (final_block || in.position() >= end ||
+        decode_block(in, dst, out, out_end, final_block, m_litlen, m_distance,
+                     m_precode) != InflateStatus::ok) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void InflateDecoder::begin(ByteSink sink) {
+  Decompressor::begin(std::move(sink));
+  m_in.clear();
+  m_in_bit = 0;
+  m_retry_len = 0;
+  m_window.clear();
+  m_window_len = 0;
+  m_out_reserve = InflateOutReserve;
+  m_done = false;
+  m_failed = false;
+}
+
+bool InflateDecoder::push(const Byte* data, const size_t n) {
+  if (m_failed) {
+    return false;
+  }
+  if (m_done) {
+    // Data after the last block is not part of the stream.
+    return true;
+  }
+  m_in.insert(m_in.end(), data, data + n);
+  if (m_in.size() < m_retry_len) {
+    return true;
+  }
+  return decode_stream(false);
+}
+
+bool InflateDecoder::finish() {
+  if (!m_failed && !m_done) {
+    (void)decode_stream(true);
+  }
+  const bool ok = !m_failed && m_done;
+  m_sink = nullptr;
+  m_in = std::vector<Byte>();
+  m_window = std::vector<Byte>();
+  return ok;
+}
+
+bool InflateDecoder::decode_stream(const bool flush) {
+  size_t in_pos = 0;
+  while (!m_done) {
+    if (m_window.size() < m_window_len + m_out_reserve) {
+      m_window.resize(m_window_len + m_out_reserve);
+    }
+    BitReader in(m_in.data() + in_pos, m_in.data() + m_in.size(), m_in_bit);
+    Byte* const out_begin = m_window.data();
+    Byte* out = out_begin + m_window_len;
+    bool last = false;
+    const InflateStatus status =
+        decode_block(in, out_begin, out, out_begin + m_window.size(), last,
+                     m_litlen, m_distance, m_precode);
+
+    if (status == InflateStatus::need_output) {
+      m_out_reserve <<= 1;
+      continue;
+    }
+    if (status == InflateStatus::need_input && !flush) {
+      // Wait until the pending input doubles, so that a large block is not
+      // decoded again for every small push.
+      m_retry_len = 2 * (m_in.size() - in_pos);
+      break;
+    }
+    if (status != InflateStatus::ok) {
+      m_failed = true;
+      return false;
+    }
+
+    emit(out_begin + m_window_len, out - (out_begin + m_window_len));
+    m_window_len = out - out_begin;
+    if (m_window_len > LZ77DictionarySize) {
+      memmove(out_begin, out - LZ77DictionarySize, LZ77DictionarySize);
+      m_window_len = LZ77DictionarySize;
+    }
+    const uint64 pos = in.position();
+    in_pos += static_cast<size_t>(pos >> 3);
+    m_in_bit = static_cast<int>(pos & 7);
+    m_done = last;
+    m_retry_len = 0;
+  }
+  m_in.erase(m_in.begin(), m_in.begin() + static_cast<ptrdiff_t>(in_pos));
+  return true;
+}
+
+}  // namespace sz
@@ -1,19 +1,56 @@
 #include "sz/common.hpp"
+#include "sz/log.hpp"
 
 #include "compress/cps_deflate.hpp"
+#include "util/kernels.hpp"
 #include "util/progress_bar.hpp"
 
 namespace sz {
 
+// Bytes processed by LZ77 between two updates of the progress bar, which is
+// shared by all workers.
+constexpr size_t LZ77ProgressBatchSize = 1 << 16;
+
+static_assert(LZ77DictionaryConfigNum == 4,
+              "LZ77Dictionary::calc() dispatches on 4 levels");
+
 void LZ77Dictionary::calc(const Byte* src, size_t n,
                           std::vector<LZ77Item>& res, ProgressBar& bar) {
+  switch (m_level) {
+    case 0:
+      calc_level<0>(src, n, res, bar);
+      break;
+    case 1:
+      calc_level<1>(src, n, res, bar);
+      break;
+    case 2:
+      calc_level<2>(src, n, res, bar);
+      break;
+    default:
+      calc_level<3>(src, n, res, bar);
+      break;
+  }
+}
+
+template <size_t Level>
+void LZ77Dictionary::calc_level(const Byte* src, size_t n,
+                                std::vector<LZ77Item>& res, ProgressBar& bar) {
+  // max chain length, good(/4), nice(/16), perfect(stop)
+  constexpr size_t MaxChain = LZ77DictionaryConfig[Level][0];
+  constexpr size_t Good = LZ77DictionaryConfig[Level][1];
+  constexpr size_t Nice = LZ77DictionaryConfig[Level][2];
+  constexpr size_t Perfect = LZ77DictionaryConfig[Level][3];
+  const kernels::MatchLengthFn match_length = kernels::active().match_length;
+
   reset();
+  m_chain_steps = 0;
 
   // Directly store literals if too short.
   if (n <= 10) {
     for (const Byte *p = src, *q = src + n; p < q; ++p) {
       res.push_back(LZ77Item{LZ77ItemType::literal, *p});
     }
+    bar.increase_progress(n);
     return;
   }
 
@@ -35,7 +72,7 @@ void LZ77Dictionary::calc(const Byte* src, size_t n,
         ++finished_bytes;
       } else {
         size_t checked = 0;
-        size_t max_check = LZ77DictionaryConfig[deflate_lz77_level][0];
+        size_t max_check = MaxChain;
         size_t max_match_len = 0;
         size_t max_match_pos = 0;
         for (const LLNode* p = m_head3b[hash3b]; p && p->pos >= m_left;
@@ -53,22 +90,18 @@ void LZ77Dictionary::calc(const Byte* src, size_t n,
           }
 
           if (base_ok) {
-            while (i + match_len < n && match_len < DeflateRepeatLenMax &&
-                   src[p->pos + match_len] == src[i + match_len]) {
-              ++match_len;
-            }
+            const size_t limit = std::min(n - i, DeflateRepeatLenMax);
+            match_len += match_length(src + p->pos + match_len,
+                                      src + i + match_len, limit - match_len);
             if (match_len > max_match_len) {
               max_match_len = match_len;
               max_match_pos = p->pos;
-              if (max_match_len >=
-                  lz77_get_config(3)) {
+              if (max_match_len >= Perfect) {
                 break;
-              } else if (max_match_len >=
-                         lz77_get_config(2)) {
-                max_check = lz77_get_config(0) >> 4;
-              } else if (max_match_len >=
-                         lz77_get_config(1)) {
-                max_check = lz77_get_config(0) >> 2;
+              } else if (max_match_len >= Nice) {
+                max_check = MaxChain >> 4;
+              } else if (max_match_len >= Good) {
+                max_check = MaxChain >> 2;
               }
             }
           }
@@ -78,6 +111,7 @@ void LZ77Dictionary::calc(const Byte* src, size_t n,
             break;
           }
         }
+        m_chain_steps += checked;
 
         skip = max_match_len - 1;
         res.push_back(LZ77Item{LZ77ItemType::length,
@@ -86,7 +120,7 @@ void LZ77Dictionary::calc(const Byte* src, size_t n,
                                   static_cast<uint16>(i - max_match_pos)});
         finished_bytes += max_match_len;
       }
-      if (finished_bytes > 64) {
+      if (finished_bytes >= LZ77ProgressBatchSize) {
         bar.increase_progress(finished_bytes);
         finished_bytes = 0;
       }
@@ -99,6 +133,15 @@ void LZ77Dictionary::calc(const Byte* src, size_t n,
     }
     m_head3b[hash3b] = new LLNode{m_head3b[hash3b], i};
   }
+  bar.increase_progress(finished_bytes);
+  m_charge.set(memory_use(n));
+}
+
+void LZ77Dictionary::set_level(const int level) {
+  if (level < 0 || static_cast<size_t>(level) >= LZ77DictionaryConfigNum) {
+    log::panic("Unrecognized LZ77 level: ", level);
+  }
+  m_level = level;
 }
 
 static uint64 get_pow_hash_root(size_t q) {
@@ -122,14 +165,19 @@ uint64 LZ77Dictionary::get_hash(const size_t pos, const size_t n) const {
 
 void LZ77Dictionary::reset() {
   m_left = 0;
+  release();
+  m_head3b.fill(nullptr);
+  m_hash.fill(0ull);
+}
+
+void LZ77Dictionary::release() {
   for (const LLNode* u : m_head3b) {
     for (const LLNode* next; u; u = next) {
       next = u->next;
       delete u;
     }
   }
-  m_head3b.fill(nullptr);
-  m_hash.fill(0ull);
+  m_charge.set(memory_use(0));
 }
 
 }  // namespace sz
\ No newline at end of file
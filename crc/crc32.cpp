@@ -52,17 +52,96 @@ constexpr uint32 CRC32ByteExtTable[] = {
     0xb40bbe37, 0xc30c8ea1, 0x5a05df1b, 0x2d02ef8d,
 };
 
+// Tables of slicing-by-8: entry b of table k is the crc of byte b followed by
+// k zero bytes, so that 8 bytes are processed by 8 independent lookups.
+struct CRC32SliceTables {
+  uint32 table[8][256];
+};
+
+constexpr CRC32SliceTables make_slice_tables() {
+  CRC32SliceTables tables{};
+  for (int b = 0; b < 256; ++b) {
+    tables.table[0][b] = CRC32ByteExtTable[b];
+  }
+  for (int k = 1; k < 8; ++k) {
+    for (int b = 0; b < 256; ++b) {
+      const uint32 prev = tables.table[k - 1][b];
+      tables.table[k][b] = (prev >> 8) ^ CRC32ByteExtTable[prev & 0xFF];
+    }
+  }
+  return tables;
+}
+
+constexpr CRC32SliceTables CRC32SliceTable = make_slice_tables();
+
+inline uint32 load_32(const Byte* p) {
+  return static_cast<uint32>(p[0]) | static_cast<uint32>(p[1]) << 8 |
+         static_cast<uint32>(p[2]) << 16 | static_cast<uint32>(p[3]) << 24;
+}
+
 CRC32Value extend(CRC32Value init_val, const Byte* data, size_t n) {
   const Byte* p = data;
   const Byte* q = data + n;
+  const auto& t = CRC32SliceTable.table;
 
   CRC32Value crc = init_val ^ CRC32InitXor;
+  while (q - p >= 8) {
+    const uint32 lo = crc ^ load_32(p);
+    const uint32 hi = load_32(p + 4);
+    crc = t[7][lo & 0xFF] ^ t[6][(lo >> 8) & 0xFF] ^ t[5][(lo >> 16) & 0xFF] ^
+          t[4][lo >> 24] ^ t[3][hi & 0xFF] ^ t[2][(hi >> 8) & 0xFF] ^
+          t[1][(hi >> 16) & 0xFF] ^ t[0][hi >> 24];
+    p += 8;
+  }
   while (p != q) {
     crc = (crc >> 8) ^ CRC32ByteExtTable[(crc & 0xFF) ^ *p++];
   }
   return crc ^ CRC32InitXor;
 }
 
+namespace {
+
+// Reflected crc-32 polynomial.
+constexpr uint32 CRC32Polynomial = 0xEDB88320u;
+
+// Multiply a and b modulo the crc-32 polynomial. Polynomials are reflected,
+// so x^0 is the highest bit.
+uint32 multiply_mod(uint32 a, uint32 b) {
+  uint32 m = 1u << 31;
+  uint32 p = 0;
+  while (true) {
+    if (a & m) {
+      p ^= b;
+      if ((a & (m - 1)) == 0) {
+        break;
+      }
+    }
+    m >>= 1;
+    b = b & 1 ? (b >> 1) ^ CRC32Polynomial : b >> 1;
+  }
+  return p;
+}
+
+// Return x^(8 * n) modulo the crc-32 polynomial, by squaring.
+uint32 shift_bytes_mod(uint64 n) {
+  uint32 p = 1u << 31;  // x^0
+  uint32 x2k = 1u << 23;  // x^8
+  while (n) {
+    if (n & 1) {
+      p = multiply_mod(x2k, p);
+    }
+    x2k = multiply_mod(x2k, x2k);
+    n >>= 1;
+  }
+  return p;
+}
+
+}  // namespace
+
+CRC32Value combine(CRC32Value crc_a, CRC32Value crc_b, uint64 len_b) {
+  return multiply_mod(shift_bytes_mod(len_b), crc_a) ^ crc_b;
+}
+
 }  // namespace crc32
 
 }  // namespace sz
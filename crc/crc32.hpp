@@ -12,6 +12,10 @@ inline CRC32Value calculate(const Byte* data, size_t n) {
   return extend(0, data, n);
 }
 
+// Return the crc-32 of the concatenation of A and B, given the crc-32 of A
+// and B and the length of B.
+CRC32Value combine(CRC32Value crc_a, CRC32Value crc_b, uint64 len_b);
+
 }  // namespace crc32
 
 }  // namespace sz
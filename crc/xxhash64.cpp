@@ -0,0 +1,96 @@
+#include "crc/xxhash64.hpp"
+
+#include <cstring>
+
+namespace sz {
+
+namespace xxhash64 {
+
+namespace {
+
+constexpr uint64 Prime1 = 0x9E3779B185EBCA87ull;
+constexpr uint64 Prime2 = 0xC2B2AE3D27D4EB4Full;
+constexpr uint64 Prime3 = 0x165667B19E3779F9ull;
+constexpr uint64 Prime4 = 0x85EBCA77C2B2AE63ull;
+constexpr uint64 Prime5 = 0x27D4EB2F165667C5ull;
+
+inline uint64 rotl(const uint64 x, const int r) {
+  return (x << r) | (x >> (64 - r));
+}
+
+inline uint64 load_64(const Byte* p) {
+  uint64 x;
+  memcpy(&x, p, sizeof(x));
+  return x;
+}
+
+inline uint32 load_32(const Byte* p) {
+  uint32 x;
+  memcpy(&x, p, sizeof(x));
+  return x;
+}
+
+inline uint64 round(uint64 acc, const uint64 input) {
+  acc += input * Prime2;
+  return rotl(acc, 31) * Prime1;
+}
+
+inline uint64 merge_round(uint64 acc, const uint64 val) {
+  acc ^= round(0, val);
+  return acc * Prime1 + Prime4;
+}
+
+}  // namespace
+
+uint64 calculate(const Byte* data, size_t n, const uint64 seed) {
+  const Byte* p = data;
+  const Byte* const end = data + n;
+  uint64 h;
+
+  if (n >= 32) {
+    uint64 v1 = seed + Prime1 + Prime2;
+    uint64 v2 = seed + Prime2;
+    uint64 v3 = seed;
+    uint64 v4 = seed - Prime1;
+    // Four independent lanes of 8 bytes each.
+    for (; p + 32 <= end; p += 32) {
+      v1 = round(v1, load_64(p));
+      v2 = round(v2, load_64(p + 8));
+      v3 = round(v3, load_64(p + 16));
+      v4 = round(v4, load_64(p + 24));
+    }
+    h = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+    h = merge_round(h, v1);
+    h = merge_round(h, v2);
+    h = merge_round(h, v3);
+    h = merge_round(h, v4);
+  } else {
+    h = seed + Prime5;
+  }
+  h += static_cast<uint64>(n);
+
+  for (; p + 8 <= end; p += 8) {
+    h ^= round(0, load_64(p));
+    h = rotl(h, 27) * Prime1 + Prime4;
+  }
+  if (p + 4 <= end) {
+    h ^= static_cast<uint64>(load_32(p)) * Prime1;
+    h = rotl(h, 23) * Prime2 + Prime3;
+    p += 4;
+  }
+  for (; p < end; ++p) {
+    h ^= static_cast<uint64>(*p) * Prime5;
+    h = rotl(h, 11) * Prime1;
+  }
+
+  h ^= h >> 33;
+  h *= Prime2;
+  h ^= h >> 29;
+  h *= Prime3;
+  h ^= h >> 32;
+  return h;
+}
+
+}  // namespace xxhash64
+
+}  // namespace sz
@@ -0,0 +1,15 @@
+#pragma once
+
+#include "sz/types.hpp"
+
+namespace sz {
+
+namespace xxhash64 {
+
+// XXH64 hash of the data, a fast non-cryptographic 64-bit hash used to
+// identify contents.
+uint64 calculate(const Byte* data, size_t n, uint64 seed = 0);
+
+}  // namespace xxhash64
+
+}  // namespace sz
@@ -1,11 +1,24 @@
 #pragma once
 
+#include <cstddef>
+
 namespace sz {
 
 inline bool log_info_switch = false;
 
-inline bool deflate_use_static = false;
-
-inline int deflate_lz77_level = 1;
+// Settings of a compression. They are passed down to each compressor, so that
+// compressions with different settings can run at the same time.
+struct CompressionOptions {
+  // Level of LZ77 (0..3). A higher level searches longer hash chains.
+  int lz77_level = 1;
+  // Encode deflate blocks with the static Huffman codes.
+  bool use_static = false;
+  // End deflate blocks on byte boundaries and index them as sections.
+  bool sync_sections = false;
+  // Minimum bytes of content per section.
+  size_t section_size = 1 << 20;
+  // Pin the deflate workers to CPUs.
+  bool pin_workers = false;
+};
 
 }  // namespace sz
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "sz/common.hpp"
+#include "sz/types.hpp"
+
+namespace sz {
+
+// A cache of compressed file contents, so that a content compressed before
+// with the same settings is not compressed again.
+// A content is identified by its XXH64 hash and size together with the
+// compression settings. The payloads in use are shared by every entry of the
+// same key, so duplicate files in an archive are compressed once. If a
+// directory is given, the payloads are also stored there, one file per key,
+// and found again by later runs.
+class CompressionCache {
+ public:
+  struct Key {
+    uint64 hash;
+    uint64 size;
+    CompressionMethod method;
+    int level;
+    bool static_coding;
+    // Minimum content per section, or 0 without sync sections.
+    size_t section_size;
+  };
+
+  struct Payload {
+    // The method actually used, which is store if deflate did not pay off.
+    CompressionMethod method;
+    CRC32Value crc32;
+    std::vector<Byte> data;
+    // Extra field of the central directory file header.
+    std::vector<Byte> extra;
+  };
+
+  // A cache file written as its payload is produced, so that the payload is
+  // never held in memory. The file is written under a temporary name and only
+  // appears once finished; an unfinished file is removed.
+  class FileWriter {
+   public:
+    FileWriter(std::string path, uint64 uncompressed_size);
+    FileWriter(const FileWriter&) = delete;
+    FileWriter& operator=(const FileWriter&) = delete;
+    FileWriter(FileWriter&&) = delete;
+    FileWriter& operator=(FileWriter&&) = delete;
+    ~FileWriter();
+
+    // Append compressed data to the payload.
+    void write(const Byte* data, size_t n);
+
+    // Append the extra field, complete the header and move the file in place.
+    // Return false, with the file removed, if it could not be written.
+    bool finish(CompressionMethod method, CRC32Value crc32,
+                const std::vector<Byte>& extra);
+
+   private:
+    std::string m_path;
+    std::string m_tmp_path;
+    uint64 m_uncompressed_size;
+    FILE* m_file;
+    uint64 m_data_length = 0;
+    bool m_ok;
+  };
+
+  // A cache kept in memory only.
+  CompressionCache() = default;
+  explicit CompressionCache(const char* dir);
+  explicit CompressionCache(const std::string& dir)
+      : CompressionCache(dir.c_str()) {}
+  CompressionCache(const CompressionCache&) = delete;
+  CompressionCache& operator=(const CompressionCache&) = delete;
+  CompressionCache(CompressionCache&&) = delete;
+  CompressionCache& operator=(CompressionCache&&) = delete;
+  ~CompressionCache() = default;
+
+  // Return the key of the content compressed by method with options.
+  [[nodiscard]] static Key make_key(const Byte* data, size_t n,
+                                    CompressionMethod method,
+                                    const CompressionOptions& options);
+
+  // Return the payload of the key, or nullptr if it is not cached.
+  [[nodiscard]] std::shared_ptr<const Payload> find(const Key& key);
+
+  // Cache the payload of the key and return it.
+  std::shared_ptr<const Payload> insert(const Key& key, Payload payload);
+
+  // Return a writer of the cache file of the key, or nullptr if the cache is
+  // kept in memory only. The payload is found by later runs once finished, but
+  // not kept in memory.
+  [[nodiscard]] std::unique_ptr<FileWriter> store_stream(const Key& key) const;
+
+  [[nodiscard]] size_t n_hits() const;
+
+ private:
+  std::string m_dir;
+  mutable std::mutex m_mutex;
+  // Payloads are only held by the entries using them.
+  std::unordered_map<std::string, std::weak_ptr<const Payload>> m_payloads;
+  size_t m_n_hits = 0;
+
+  [[nodiscard]] std::shared_ptr<const Payload> load(const std::string& name,
+                                                    const Key& key) const;
+  void store(const std::string& name, const Key& key,
+             const Payload& payload) const;
+};
+
+}  // namespace sz
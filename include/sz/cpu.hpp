@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+namespace sz {
+
+namespace cpu {
+
+// Number of CPUs the process may actually run on: the CPUs of its affinity
+// mask, capped by the CPU quota of its cgroup (v1 or v2), and at least 1.
+// Inside a container, std::thread::hardware_concurrency() reports the cores
+// of the host instead.
+[[nodiscard]] size_t available_cpus();
+
+// The smallest CPU quota of the cgroups listed in proc_cgroup, the content of
+// /proc/self/cgroup, whose hierarchies are mounted under root, or 0 if there
+// is none.
+[[nodiscard]] size_t cgroup_cpus(const std::string& proc_cgroup,
+                                 const std::string& root);
+
+// Pin the calling thread to a CPU of the affinity mask of the process, the
+// worker-th one modulo their number. Memory first touched by the thread is
+// then allocated on the NUMA node of that CPU.
+// Return false if the thread cannot be pinned.
+bool pin_thread(size_t worker);
+
+// Instruction sets the kernels have variants for, each one a superset of the
+// previous ones.
+enum class Isa {
+  generic,
+  sse2,
+  avx2,
+  // AVX-512 F and BW.
+  avx512,
+};
+
+[[nodiscard]] const char* isa_name(Isa isa);
+
+// Set isa to the instruction set named name, as printed by isa_name().
+// Return false if there is none.
+bool parse_isa(const std::string& name, Isa& isa);
+
+// The best instruction set of the CPU and the OS, probed once with CPUID.
+[[nodiscard]] Isa detected_isa();
+
+// The instruction set the kernels are bound to: detected_isa(), lowered to
+// the one named by the SZ_FORCE_ISA environment variable if it is set.
+[[nodiscard]] Isa active_isa();
+
+}  // namespace cpu
+
+}  // namespace sz
@@ -4,11 +4,16 @@
 #include <string>
 #include <vector>
 
+#include "sz/common.hpp"
+#include "sz/compression_cache.hpp"
+#include "sz/memory.hpp"
+#include "sz/stats.hpp"
 #include "sz/types.hpp"
 
 namespace sz {
 
 class Compressor;
+struct EntryRecord;
 
 class FileEntry {
  public:
@@ -16,6 +21,20 @@ class FileEntry {
   FileEntry(const char* filename, CompressionMethod method, size_t thread_cnt);
   FileEntry(const std::string& str, CompressionMethod method, size_t thread_cnt)
       : FileEntry(str.c_str(), method, thread_cnt) {}
+  FileEntry(const char* filename, CompressionMethod method, size_t thread_cnt,
+            const CompressionOptions& options);
+  FileEntry(const std::string& str, CompressionMethod method, size_t thread_cnt,
+            const CompressionOptions& options)
+      : FileEntry(str.c_str(), method, thread_cnt, options) {}
+  // Take the compressed content from the cache if it is there, and put it
+  // there once compressed otherwise.
+  FileEntry(const char* filename, CompressionMethod method, size_t thread_cnt,
+            const CompressionOptions& options,
+            std::shared_ptr<CompressionCache> cache);
+  FileEntry(const std::string& str, CompressionMethod method, size_t thread_cnt,
+            const CompressionOptions& options,
+            std::shared_ptr<CompressionCache> cache)
+      : FileEntry(str.c_str(), method, thread_cnt, options, std::move(cache)) {}
 
   void compress();
 
@@ -33,13 +52,19 @@ class FileEntry {
 
   [[nodiscard]] SizeType get_compressed_size() const;
 
+  // Statistics of the entry, complete after compress().
+  [[nodiscard]] EntryStats get_stats() const;
+
   void write_local_file_header(std::vector<Byte>& buffer) const;
   void write_file_block(std::vector<Byte>& buffer) const;
+  // Pass the file data to sink without an intermediate buffer.
+  void write_file_block(const ByteSink& sink) const;
   void write_central_directory_file_header(std::vector<Byte>& buffer,
                                            Offset off_local_file_header) const;
 
  private:
   std::vector<Byte> m_raw;
+  memory::Charge m_raw_charge;
 
   OptVersion m_ver_made;
   OptVersion m_ver_extract;
@@ -55,6 +80,21 @@ class FileEntry {
   std::string m_comment;
 
   std::shared_ptr<Compressor> m_compressor;
+
+  std::shared_ptr<CompressionCache> m_cache;
+  CompressionCache::Key m_cache_key;
+  // The compressed content if it is held by the cache instead of the
+  // compressor.
+  std::shared_ptr<const CompressionCache::Payload> m_payload;
+
+  // Seconds spent on the crc-32 and the compression.
+  double m_seconds;
+  // Whether the compressed content was found in the cache.
+  bool m_cached;
+  // Deflate blocks of the compressed content.
+  std::vector<BlockStats> m_block_stats;
+
+  [[nodiscard]] EntryRecord make_record(Offset off_local_file_header) const;
 };
 
 }  // namespace sz
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <array>
+#include <ostream>
+
+#include "sz/types.hpp"
+
+namespace sz {
+
+namespace memory {
+
+// The subsystems whose large buffers are accounted for.
+enum class Use {
+  // File contents read into memory, and content pending in a stream.
+  source,
+  // LZ77 dictionaries and the items they produce.
+  lz77,
+  // Encoded deflate blocks waiting to be concatenated.
+  encoded,
+  // Compressed contents held by the compression cache.
+  payload,
+  // Archives assembled in memory.
+  archive,
+};
+
+constexpr size_t NUses = 5;
+
+// Bytes in use, current and peak, by subsystem and in total.
+struct Report {
+  std::array<uint64, NUses> current;
+  std::array<uint64, NUses> peak;
+  uint64 current_total;
+  // The peak of the sum, which is at most the sum of the peaks.
+  uint64 peak_total;
+};
+
+[[nodiscard]] const char* use_name(Use use);
+
+void charge(Use use, uint64 bytes);
+void release(Use use, uint64 bytes);
+
+[[nodiscard]] Report report();
+
+// Restart the peaks from the current use.
+void reset_peaks();
+
+// Write the report as "total peak (use peak, ...)" in MB.
+void write_report(std::ostream& os, const Report& report);
+
+// Set the bytes the subsystems should stay under, or 0 for no budget.
+// The budget is kept by running fewer workers at a time; it cannot be kept if
+// a single worker does not fit.
+void set_budget(uint64 bytes);
+[[nodiscard]] uint64 get_budget();
+
+// Return how many of requested workers, each using per_worker bytes, fit in
+// what is left of the budget, and at least 1.
+[[nodiscard]] size_t fit_workers(size_t requested, uint64 per_worker);
+
+// Bytes of a use held by an object, released when the object is destroyed.
+// A copy charges the same bytes again, as the object it belongs to holds a
+// copy of the buffer.
+class Charge {
+ public:
+  Charge() = delete;
+  explicit Charge(const Use use, const uint64 bytes = 0)
+      : m_use(use), m_bytes(bytes) {
+    charge(m_use, m_bytes);
+  }
+  Charge(const Charge& other) : Charge(other.m_use, other.m_bytes) {}
+  Charge& operator=(const Charge& other) {
+    if (this != &other) {
+      release(m_use, m_bytes);
+      m_use = other.m_use;
+      m_bytes = other.m_bytes;
+      charge(m_use, m_bytes);
+    }
+    return *this;
+  }
+  Charge(Charge&& other) noexcept : m_use(other.m_use), m_bytes(other.m_bytes) {
+    other.m_bytes = 0;
+  }
+  Charge& operator=(Charge&& other) noexcept {
+    if (this != &other) {
+      release(m_use, m_bytes);
+      m_use = other.m_use;
+      m_bytes = other.m_bytes;
+      other.m_bytes = 0;
+    }
+    return *this;
+  }
+  ~Charge() { release(m_use, m_bytes); }
+
+  // Change the bytes held to bytes.
+  void set(const uint64 bytes) {
+    if (bytes > m_bytes) {
+      charge(m_use, bytes - m_bytes);
+    } else {
+      release(m_use, m_bytes - bytes);
+    }
+    m_bytes = bytes;
+  }
+
+  [[nodiscard]] uint64 bytes() const { return m_bytes; }
+
+ private:
+  Use m_use;
+  uint64 m_bytes;
+};
+
+}  // namespace memory
+
+}  // namespace sz
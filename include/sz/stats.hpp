@@ -0,0 +1,51 @@
+#pragma once
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "sz/types.hpp"
+
+namespace sz {
+
+enum class BlockType { store, static_coding, dynamic_coding };
+
+// Statistics of a deflate block.
+struct BlockStats {
+  BlockType type;
+  uint64 input_bytes;
+  // Bits of the block, without the sync block following it.
+  uint64 output_bits;
+  uint64 n_literals;
+  uint64 n_matches;
+  // Total length of the matches.
+  uint64 match_bytes;
+  // Candidates of the hash chains compared by LZ77.
+  uint64 chain_steps;
+  double lz77_seconds;
+  double encode_seconds;
+};
+
+// Statistics of an entry of an archive.
+struct EntryStats {
+  std::string name;
+  CompressionMethod method;
+  uint64 uncompressed_size;
+  uint64 compressed_size;
+  // Time of compression, including the crc-32.
+  double seconds;
+  // Whether the compressed content was reused instead of compressed: taken
+  // from a CompressionCache or copied from another archive.
+  bool reused;
+  // Deflate blocks in stream order, empty for other methods.
+  std::vector<BlockStats> blocks;
+};
+
+// Write the statistics as a JSON array of entries, each with its blocks.
+void write_stats_json(std::ostream& os, const std::vector<EntryStats>& stats);
+
+// Write the statistics as CSV, one row per block, or per entry without
+// blocks, with the columns of the entry repeated on every row.
+void write_stats_csv(std::ostream& os, const std::vector<EntryStats>& stats);
+
+}  // namespace sz
@@ -1,7 +1,15 @@
 #pragma once
 
 #include "sz/common.hpp"
+#include "sz/compression_cache.hpp"
+#include "sz/cpu.hpp"
 #include "sz/file_entry.hpp"
 #include "sz/log.hpp"
+#include "sz/memory.hpp"
+#include "sz/stats.hpp"
+#include "sz/trace.hpp"
 #include "sz/types.hpp"
+#include "sz/unzipper.hpp"
+#include "sz/zip_reader.hpp"
+#include "sz/zip_writer.hpp"
 #include "sz/zipper.hpp"
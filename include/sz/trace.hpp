@@ -0,0 +1,117 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "sz/types.hpp"
+
+namespace sz {
+
+namespace trace {
+
+// A span of time spent by a thread, a complete event ("ph": "X") of the
+// Chrome trace event format.
+struct Event {
+  // A string literal, written without escaping.
+  const char* name;
+  uint64 start_ns;
+  uint64 duration_ns;
+  // Bytes processed by the span, omitted if 0.
+  uint64 bytes;
+};
+
+// The events of a lane of the timeline. Only the thread that owns it appends
+// to it, so recording takes no lock. When the thread exits, the buffer is
+// kept until the events are written, and handed to the next thread that
+// records, whose events all come after.
+struct ThreadBuffer {
+  uint32 tid;
+  std::vector<Event> events;
+};
+
+#ifdef SZ_DISABLE_TRACE
+constexpr bool is_enabled() { return false; }
+#else
+inline std::atomic<bool> enabled_switch{false};
+
+inline bool is_enabled() {
+  return enabled_switch.load(std::memory_order_relaxed);
+}
+#endif
+
+inline uint64 now_ns() {
+  return static_cast<uint64>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now().time_since_epoch())
+          .count());
+}
+
+// Drop the recorded events and start recording. No thread may be recording
+// meanwhile.
+void enable();
+// Stop recording. The events are kept until enable().
+void disable();
+
+// The buffer of the calling thread, taken from an exited thread or registered
+// on first use.
+ThreadBuffer& thread_buffer();
+
+// Write the events of all threads as trace event JSON, which is opened by
+// chrome://tracing and Perfetto. The threads that record must have stopped.
+void write_json(std::ostream& os);
+
+// Record the time from construction to end() or destruction on the calling
+// thread. Nothing is read or recorded unless tracing is enabled.
+class Span {
+ public:
+  Span() = delete;
+  explicit Span(const char* name, const uint64 bytes = 0)
+      : m_name(nullptr), m_start_ns(0), m_bytes(bytes) {
+    if (is_enabled()) {
+      m_name = name;
+      m_start_ns = now_ns();
+    }
+  }
+  Span(const Span&) = delete;
+  Span& operator=(const Span&) = delete;
+  Span(Span&&) = delete;
+  Span& operator=(Span&&) = delete;
+  ~Span() { end(); }
+
+  void end() {
+    if (m_name) {
+      thread_buffer().events.push_back(
+          Event{m_name, m_start_ns, now_ns() - m_start_ns, m_bytes});
+      m_name = nullptr;
+    }
+  }
+
+ private:
+  const char* m_name;
+  uint64 m_start_ns;
+  uint64 m_bytes;
+};
+
+// Record while it lives, and write the events to filename when destroyed.
+// Nothing is recorded if filename is empty.
+class Session {
+ public:
+  Session() = delete;
+  explicit Session(std::string filename);
+  Session(const Session&) = delete;
+  Session& operator=(const Session&) = delete;
+  Session(Session&&) = delete;
+  Session& operator=(Session&&) = delete;
+  ~Session();
+
+ private:
+  std::string m_filename;
+};
+
+}  // namespace trace
+
+}  // namespace sz
@@ -1,6 +1,8 @@
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
+#include <functional>
 
 namespace sz {
 
@@ -33,8 +35,9 @@ using Timestamp = struct {
 // 32-bit CRC32 value
 using CRC32Value     = uint32;
 
-// 4-byte integer used to indicate size
-using SizeType       = uint32;
+// 8-byte integer used to indicate size
+// Written in 4 bytes unless it needs the ZIP64 format
+using SizeType       = uint64;
 // 2-byte integer used to indicate length
 using LengthType     = uint16;
 
@@ -46,12 +49,16 @@ using InternalAttr   = uint16;
 // 4-byte External file attributes
 using ExternalAttr   = uint32;
 
-// 4-byte Offset type
-using Offset         = uint32;
+// 8-byte Offset type
+// Written in 4 bytes unless it needs the ZIP64 format
+using Offset         = uint64;
 
 // 2-byte Number of records
 using NRecord        = uint16;
 
+// Receiver of a byte stream that is produced piece by piece
+using ByteSink       = std::function<void(const Byte* data, size_t n)>;
+
 // clang-format on
 
 }  // namespace sz
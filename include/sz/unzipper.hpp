@@ -0,0 +1,65 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "sz/types.hpp"
+#include "sz/zip_reader.hpp"
+
+namespace sz {
+
+// Summary of an operation over the entries of an archive.
+struct UnzipReport {
+  // Number of entries processed successfully.
+  size_t n_entries = 0;
+  // Total uncompressed size of the entries processed successfully.
+  uint64 n_bytes = 0;
+  // Names of the entries that failed.
+  std::vector<std::string> failures;
+};
+
+// Extracts or tests the entries of an archive with several threads.
+// Entries are distributed among the workers one at a time, larger entries
+// first, so that many small entries and a few large ones are both balanced.
+class Unzipper {
+ public:
+  Unzipper() = delete;
+  Unzipper(const ZipReader& reader, size_t thread_cnt);
+  Unzipper(const Unzipper&) = delete;
+  Unzipper& operator=(const Unzipper&) = delete;
+  Unzipper(Unzipper&&) = delete;
+  Unzipper& operator=(Unzipper&&) = delete;
+  ~Unzipper() = default;
+
+  // Extract the entries of the given names into directory dir, or all entries
+  // if names is empty. Each output file is allocated at its final size and
+  // written at offsets, and its crc-32 is verified while it is decoded.
+  // Entries with a section index are inflated by all workers together.
+  // Entries whose names escape dir are refused.
+  // The output file of an entry that fails is removed.
+  [[nodiscard]] UnzipReport extract(const std::vector<std::string>& names,
+                                    const std::string& dir) const;
+
+  // Decode the entries of the given names, or all entries if names is empty,
+  // and verify their crc-32 and sizes against the central directory without
+  // writing anything.
+  [[nodiscard]] UnzipReport test(const std::vector<std::string>& names) const;
+
+ private:
+  const ZipReader& m_reader;
+  size_t m_thread_cnt;
+
+  // Return the entries of the given names, or all entries if names is empty.
+  // Names not found are added to the failures of report.
+  [[nodiscard]] std::vector<const ZipReader::Entry*> select(
+      const std::vector<std::string>& names, UnzipReport& report) const;
+
+  // Call fn(entry, worker) for every entry on m_thread_cnt workers, where
+  // worker is the index of the calling worker. Entries for which fn returns
+  // false are added to the failures of report.
+  template <typename Fn>
+  void for_each(std::vector<const ZipReader::Entry*> entries, Fn fn,
+                UnzipReport& report) const;
+};
+
+}  // namespace sz
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "sz/types.hpp"
+
+namespace sz {
+
+namespace io {
+class MappedFile;
+}
+
+// A reader of a zip file. The archive is memory mapped, and only its central
+// directory is parsed when it is opened: entries are indexed by name in a
+// hash table, so that an entry is found without touching any local file
+// header.
+class ZipReader {
+ public:
+  // An entry of the central directory.
+  struct Entry {
+    CRC32Value crc32;
+    CompressionMethod method;
+    GeneralPurpose general_purpose;
+    Timestamp last_modify_time;
+    SizeType compressed_size;
+    SizeType uncompressed_size;
+    Offset off_local_file_header;
+    // Offset of the central directory file header of the entry.
+    Offset off_cd_header;
+    // Offset of the file name in the archive.
+    Offset off_name;
+    LengthType name_length;
+    // Offset of the first record of the section index of the entry, and the
+    // number of sections, or 0 if the entry has no section index.
+    Offset off_sections;
+    uint32 n_sections;
+  };
+
+  // Receiver of a piece of decompressed content at offset off of the entry.
+  using PositionalSink =
+      std::function<void(uint64 off, const Byte* data, size_t n)>;
+
+  ZipReader() = delete;
+  explicit ZipReader(const char* filename);
+  explicit ZipReader(const std::string& filename)
+      : ZipReader(filename.c_str()) {}
+  ZipReader(const ZipReader&) = delete;
+  ZipReader& operator=(const ZipReader&) = delete;
+  ZipReader(ZipReader&&) = delete;
+  ZipReader& operator=(ZipReader&&) = delete;
+  ~ZipReader();
+
+  // Whether the archive is mapped and its central directory is valid.
+  [[nodiscard]] bool is_open() const { return m_open; }
+
+  [[nodiscard]] size_t n_entries() const { return m_entries.size(); }
+  [[nodiscard]] const std::vector<Entry>& entries() const { return m_entries; }
+  [[nodiscard]] const Entry& entry(size_t i) const { return m_entries[i]; }
+
+  [[nodiscard]] std::string_view name(const Entry& entry) const;
+
+  // Return the entry of the given name, or nullptr if there is none.
+  [[nodiscard]] const Entry* find(std::string_view name) const;
+
+  // The mapped archive.
+  [[nodiscard]] const io::MappedFile& file() const { return *m_file; }
+
+  // Return the compressed data of the entry in the mapped archive, or nullptr
+  // if its local file header is corrupted.
+  [[nodiscard]] const Byte* data(const Entry& entry) const;
+
+  // Decompress the entry into dst of entry.uncompressed_size bytes and verify
+  // its crc-32. Return false if the entry is corrupted or the method is not
+  // supported.
+  [[nodiscard]] bool extract(const Entry& entry, Byte* dst) const;
+
+  // Decompress the entry chunk by chunk, passing the content to sink, and
+  // verify its length and crc-32 on the fly.
+  // Return false if the entry is corrupted or the method is not supported.
+  [[nodiscard]] bool extract(const Entry& entry, const ByteSink& sink) const;
+
+  // Decompress len bytes of the entry from offset off into dst. Decoding
+  // starts at the section containing off, or at the start of the entry if it
+  // has no section index, and stops once the range is complete. The crc-32
+  // is not verified. Return false if the range is out of the entry, the
+  // entry is corrupted or the method is not supported.
+  [[nodiscard]] bool read(const Entry& entry, uint64 off, size_t len,
+                          Byte* dst) const;
+
+  // Decompress the sections of the entry on thread_cnt threads, passing each
+  // one to sink, which is called from several threads at once. The crc-32 of
+  // the sections are combined and verified at the end. An entry without a
+  // section index is decompressed as a stream by the calling thread.
+  // Return false if the entry is corrupted or the method is not supported.
+  [[nodiscard]] bool extract_parallel(const Entry& entry, size_t thread_cnt,
+                                      const PositionalSink& sink) const;
+
+ private:
+  std::shared_ptr<io::MappedFile> m_file;
+  bool m_open;
+  std::vector<Entry> m_entries;
+
+  // Open addressing hash table of entry indices.
+  struct Slot {
+    // High bits of the hash of the name, compared before the name itself.
+    uint32 tag;
+    // Index of the entry, or EmptySlot.
+    uint32 index;
+  };
+  static constexpr uint32 EmptySlot = 0xFFFFFFFF;
+  std::vector<Slot> m_slots;
+
+  // Parse the end of central directory records and the central directory.
+  [[nodiscard]] bool parse();
+  [[nodiscard]] bool parse_central_directory(uint64 off_cd, uint64 len_cd,
+                                             uint64 n_entries);
+  // Read a range of an entry without a section index, decoding it as a
+  // stream from its start.
+  [[nodiscard]] bool read_stream(const Entry& entry, const Byte* src,
+                                 uint64 off, size_t len, Byte* dst) const;
+  // Whether the lengths of the sections of the entry add up to its sizes.
+  [[nodiscard]] bool check_sections(const Entry& entry) const;
+  void build_index();
+};
+
+}  // namespace sz
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "sz/common.hpp"
+#include "sz/compression_cache.hpp"
+#include "sz/stats.hpp"
+#include "sz/types.hpp"
+#include "sz/zip_reader.hpp"
+
+namespace sz {
+
+namespace io {
+class AsyncFileWriter;
+}
+
+struct EntryRecord;
+
+// A zip writer that streams each entry to the target file as soon as it is
+// compressed. Only the central directory records stay in memory, so the
+// memory use does not depend on the size of the archive.
+// The sizes of an entry are not known before it is compressed, so they are
+// written into a data descriptor (general purpose bit 3) after the file data.
+// Entries whose source file is close to 4 GB or larger are written in ZIP64
+// format, decided from the size of the source file before it is compressed.
+// Stored entries are spliced from the source file by the kernel where
+// possible, after their crc-32 is computed by a first pass over the file.
+class ZipWriter {
+ public:
+  ZipWriter() = delete;
+  explicit ZipWriter(const char* filename);
+  explicit ZipWriter(const std::string& filename)
+      : ZipWriter(filename.c_str()) {}
+  ZipWriter(const ZipWriter&) = delete;
+  ZipWriter& operator=(const ZipWriter&) = delete;
+  ZipWriter(ZipWriter&&) = delete;
+  ZipWriter& operator=(ZipWriter&&) = delete;
+  // Close the archive if it has not been closed.
+  ~ZipWriter();
+
+  [[nodiscard]] bool is_open() const;
+  [[nodiscard]] size_t n_entries() const;
+
+  // Compress the file and append it to the archive.
+  void add_file(const char* filename, CompressionMethod method,
+                size_t thread_cnt) {
+    add_file(filename, method, thread_cnt, CompressionOptions());
+  }
+  void add_file(const std::string& filename, CompressionMethod method,
+                size_t thread_cnt) {
+    add_file(filename.c_str(), method, thread_cnt);
+  }
+  void add_file(const char* filename, CompressionMethod method,
+                size_t thread_cnt, const CompressionOptions& options) {
+    add_file(filename, method, thread_cnt, options, nullptr);
+  }
+  void add_file(const std::string& filename, CompressionMethod method,
+                size_t thread_cnt, const CompressionOptions& options) {
+    add_file(filename.c_str(), method, thread_cnt, options);
+  }
+  // Copy the compressed content from the cache if it is there, and stream it
+  // to the cache directory as it is compressed otherwise. A cache kept in
+  // memory only is not filled. The file is mapped and hashed first to find its
+  // key.
+  void add_file(const char* filename, CompressionMethod method,
+                size_t thread_cnt, const CompressionOptions& options,
+                const std::shared_ptr<CompressionCache>& cache);
+  void add_file(const std::string& filename, CompressionMethod method,
+                size_t thread_cnt, const CompressionOptions& options,
+                const std::shared_ptr<CompressionCache>& cache) {
+    add_file(filename.c_str(), method, thread_cnt, options, cache);
+  }
+
+  // Append an entry of another archive as it is: its compressed data, crc-32
+  // and sizes are copied without being decompressed, and so is its section
+  // index. A new local file header is written with the sizes in it.
+  // Return false, with nothing appended, if the local file header of the
+  // entry is corrupted.
+  [[nodiscard]] bool add_raw_entry(const ZipReader& reader,
+                                   const ZipReader::Entry& entry);
+
+  // Append the entry of reader named filename by add_raw_entry() if the file
+  // has not changed since, that is, it has the same size and modification
+  // time, and the entry is compressed by method. Return false, with nothing
+  // appended, otherwise.
+  [[nodiscard]] bool reuse_entry(const ZipReader& reader, const char* filename,
+                                 CompressionMethod method);
+  [[nodiscard]] bool reuse_entry(const ZipReader& reader,
+                                 const std::string& filename,
+                                 CompressionMethod method) {
+    return reuse_entry(reader, filename.c_str(), method);
+  }
+
+  // Statistics of the entries appended so far, in order.
+  [[nodiscard]] const std::vector<EntryStats>& get_stats() const {
+    return m_stats;
+  }
+
+  // Write the central directory and close the archive.
+  // Return false if the archive cannot be written.
+  [[nodiscard]] bool close();
+
+ private:
+  std::shared_ptr<io::AsyncFileWriter> m_out;
+  std::vector<EntryRecord> m_records;
+  std::vector<EntryStats> m_stats;
+  std::string m_comment;
+  bool m_closed;
+
+  // Append the file as a stored entry.
+  void add_stored_file(const char* filename);
+
+  // Append the file of uncompressed_size bytes with the compressed content of
+  // payload, which started at start.
+  void add_cached_file(const char* filename, uint64 uncompressed_size,
+                       const CompressionCache::Payload& payload, double start);
+
+  // Record the statistics of the entry appended, which took the time since
+  // start.
+  void add_stats(const EntryRecord& record, double start, bool reused,
+                 std::vector<BlockStats> blocks);
+};
+
+}  // namespace sz
@@ -3,29 +3,41 @@
 #include <vector>
 
 #include "sz/file_entry.hpp"
+#include "sz/memory.hpp"
 
 namespace sz {
 
 class Zipper {
  public:
-  Zipper() : m_buffer_ready(false) {}
+  Zipper() : m_buffer_charge(memory::Use::archive), m_buffer_ready(false) {}
 
   [[nodiscard]] size_t n_entries() const { return m_entries.size(); }
   [[nodiscard]] size_t get_comment_length() const { return m_comment.length(); }
 
   void add_entry(FileEntry&& entry) {
     entry.compress();
-    m_entries.push_back(entry);
+    m_entries.push_back(std::move(entry));
   }
   void update_buffer();
   [[nodiscard]] bool ready() const { return m_buffer_ready; }
+  // Statistics of the entries, in order.
+  [[nodiscard]] std::vector<EntryStats> get_stats() const;
   [[nodiscard]] bool write(const char* filename) const;
   [[nodiscard]] bool write(const std::string& filename) const;
+  // Write the zip file without building it in memory: the target is allocated
+  // at its final size, and thread_cnt workers write the entries directly at
+  // their offsets. The central directory is written last.
+  // update_buffer() is not needed before this call.
+  [[nodiscard]] bool write_parallel(const char* filename,
+                                    size_t thread_cnt) const;
+  [[nodiscard]] bool write_parallel(const std::string& filename,
+                                    size_t thread_cnt) const;
 
  private:
   std::vector<FileEntry> m_entries;
   std::string m_comment;
   std::vector<Byte> m_buffer;
+  memory::Charge m_buffer_charge;
   bool m_buffer_ready;
 
   void write_eocd(size_t off_cd);
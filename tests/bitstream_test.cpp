@@ -1,6 +1,7 @@
 #include <algorithm>
 #include <cstdlib>
 #include <memory>
+#include <vector>
 
 #include "sz/sz.hpp"
 
@@ -130,3 +131,42 @@ TEST(util, BitStream_append) {
   delete[] res;
   delete[] arr;
 }
+
+TEST(util, BitStreamWriter_append) {
+  constexpr int StreamCnt = 64;
+  constexpr int MaxLen = 4096;
+  std::vector<sz::Byte> written;
+  sz::BitStreamWriter writer(
+      [&written](const sz::Byte* data, size_t n) {
+        written.insert(written.end(), data, data + n);
+      });
+  auto expected = std::make_shared<sz::BitStream>();
+
+  for (int t = 0; t < StreamCnt; ++t) {
+    auto bs = std::make_shared<sz::BitStream>();
+    const int len = rand() % MaxLen;
+    for (int i = 0, j; i < len; i = j + 1) {
+      j = i + rand() % std::min(len - i, SingleDataMaxLen);
+      const sz::uint32 val = static_cast<sz::uint32>(rand());
+      bs->write_bits(val, j - i + 1);
+    }
+    writer.append(*bs);
+    expected->append(*bs);
+    if (t % 8 == 0) {
+      // Byte aligned content is passed through directly.
+      writer.align_to_byte();
+      expected->align_to_byte(0);
+      const sz::Byte raw[] = {0x12, 0x34, 0x56};
+      writer.write_bytes(raw, 3);
+      for (auto&& x : raw) {
+        expected->write_bits(x, 8);
+      }
+    }
+  }
+  EXPECT_EQ(writer.get_bits_size(), expected->get_bits_size());
+  writer.flush();
+
+  std::vector<sz::Byte> res(expected->get_bytes_size());
+  expected->export_bitstream(res.data());
+  EXPECT_EQ(written, res);
+}
@@ -0,0 +1,174 @@
+#include <cstdio>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "sz/compression_cache.hpp"
+#include "sz/zip_reader.hpp"
+#include "sz/zip_writer.hpp"
+#include "sz/zipper.hpp"
+
+#include "crc/xxhash64.hpp"
+#include "util/byte_util.hpp"
+#include "util/fs.hpp"
+
+#include "gtest/gtest.h"
+
+TEST(compression_cache, xxhash64) {
+  const std::string abc = "abc";
+  EXPECT_EQ(sz::xxhash64::calculate(nullptr, 0), 0xEF46DB3751D8E999ull);
+  EXPECT_EQ(sz::xxhash64::calculate(
+                reinterpret_cast<const sz::Byte*>(abc.data()), abc.size()),
+            0x44BC2CF5AD770999ull);
+}
+
+TEST(compression_cache, reuse_payloads) {
+  const std::vector<std::string> filenames = {
+      "compression_cache_test_a.txt", "compression_cache_test_b.txt",
+      "compression_cache_test_c.txt"};
+  std::vector<sz::Byte> content;
+  for (int i = 0; i < 100000; ++i) {
+    content.push_back(static_cast<sz::Byte>('a' + rand() % 6));
+  }
+  // The first two files have the same content.
+  sz::io::write_bytes(filenames[0].c_str(), content);
+  sz::io::write_bytes(filenames[1].c_str(), content);
+  std::vector<sz::Byte> other(content.begin(), content.begin() + 5000);
+  sz::io::write_bytes(filenames[2].c_str(), other);
+
+  const std::string dir = "compression_cache_test_dir";
+  std::filesystem::remove_all(dir);
+  const sz::CompressionOptions options;
+  for (int run = 0; run < 2; ++run) {
+    auto cache = std::make_shared<sz::CompressionCache>(dir);
+    sz::Zipper zipper;
+    for (const auto& filename : filenames) {
+      sz::FileEntry entry(filename, sz::CompressionMethod::deflate, 2, options,
+                          cache);
+      entry.compress();
+      zipper.add_entry(std::move(entry));
+    }
+    // Within the first run, only the duplicate hits; the second run finds
+    // every file in the directory.
+    EXPECT_EQ(cache->n_hits(), run == 0 ? 1 : 3);
+    zipper.update_buffer();
+    ASSERT_TRUE(zipper.write("compression_cache_test.zip"));
+
+    sz::ZipReader reader("compression_cache_test.zip");
+    ASSERT_TRUE(reader.is_open());
+    ASSERT_EQ(reader.n_entries(), filenames.size());
+    for (size_t i = 0; i < filenames.size(); ++i) {
+      const auto& entry = reader.entry(i);
+      std::vector<sz::Byte> dst(entry.uncompressed_size);
+      EXPECT_TRUE(reader.extract(entry, dst.data()));
+      EXPECT_EQ(dst, i < 2 ? content : other);
+    }
+  }
+
+  for (const auto& filename : filenames) {
+    std::remove(filename.c_str());
+  }
+  std::remove("compression_cache_test.zip");
+  std::filesystem::remove_all(dir);
+
+  // Another level compresses to another payload.
+  sz::CompressionOptions level3;
+  level3.lz77_level = 3;
+  EXPECT_NE(sz::CompressionCache::make_key(content.data(), content.size(),
+                                           sz::CompressionMethod::deflate,
+                                           options)
+                .level,
+            sz::CompressionCache::make_key(content.data(), content.size(),
+                                           sz::CompressionMethod::deflate,
+                                           level3)
+                .level);
+}
+
+TEST(compression_cache, stream_writer) {
+  const std::string filename = "compression_cache_test_stream.txt";
+  std::vector<sz::Byte> content;
+  for (int i = 0; i < (3 << 20); ++i) {
+    content.push_back(static_cast<sz::Byte>('a' + rand() % 6));
+  }
+  sz::io::write_bytes(filename.c_str(), content);
+
+  const std::string dir = "compression_cache_test_stream_dir";
+  std::filesystem::remove_all(dir);
+  sz::CompressionOptions options;
+  options.sync_sections = true;
+  for (int run = 0; run < 2; ++run) {
+    auto cache = std::make_shared<sz::CompressionCache>(dir);
+    {
+      sz::ZipWriter writer("compression_cache_test_stream.zip");
+      writer.add_file(filename, sz::CompressionMethod::deflate, 2, options,
+                      cache);
+      ASSERT_TRUE(writer.close());
+      EXPECT_EQ(writer.get_stats()[0].reused, run == 1);
+    }
+    // The second run takes the content and its section index from the
+    // directory.
+    EXPECT_EQ(cache->n_hits(), run == 0 ? 0 : 1);
+
+    sz::ZipReader reader("compression_cache_test_stream.zip");
+    ASSERT_TRUE(reader.is_open());
+    const auto& entry = reader.entry(0);
+    EXPECT_GT(entry.n_sections, 1);
+    std::vector<sz::Byte> dst(entry.uncompressed_size);
+    EXPECT_TRUE(reader.extract(entry, dst.data()));
+    EXPECT_EQ(dst, content);
+  }
+
+  std::remove(filename.c_str());
+  std::remove("compression_cache_test_stream.zip");
+  std::filesystem::remove_all(dir);
+}
+
+TEST(compression_cache, ignore_damaged_files) {
+  std::vector<sz::Byte> content;
+  for (int i = 0; i < 100000; ++i) {
+    content.push_back(static_cast<sz::Byte>('a' + rand() % 6));
+  }
+  const std::string dir = "compression_cache_test_damaged_dir";
+  std::filesystem::remove_all(dir);
+  const auto key = sz::CompressionCache::make_key(
+      content.data(), content.size(), sz::CompressionMethod::deflate,
+      sz::CompressionOptions());
+  {
+    sz::CompressionCache cache(dir);
+    (void)cache.insert(key, sz::CompressionCache::Payload{
+                                sz::CompressionMethod::deflate, 0,
+                                std::vector<sz::Byte>(5000, 'x'), {}});
+  }
+  {
+    sz::CompressionCache cache(dir);
+    EXPECT_NE(cache.find(key), nullptr);
+  }
+
+  // A byte flipped in the payload keeps the sizes right.
+  for (const auto& file : std::filesystem::directory_iterator(dir)) {
+    const std::string path = file.path().string();
+    auto bytes = sz::io::read_bytes(path.c_str());
+    bytes[bytes.size() / 2] ^= 0x10;
+    sz::io::write_bytes(path.c_str(), bytes);
+  }
+  {
+    sz::CompressionCache cache(dir);
+    EXPECT_EQ(cache.find(key), nullptr);
+  }
+
+  // Lengths whose sum wraps around to the payload length.
+  for (const auto& file : std::filesystem::directory_iterator(dir)) {
+    const std::string path = file.path().string();
+    auto bytes = sz::io::read_bytes(path.c_str());
+    sz::Byte* p = bytes.data() + 18;
+    sz::marshal_64(p, ~static_cast<sz::uint64>(0));
+    sz::marshal_32(p, 5001);
+    sz::io::write_bytes(path.c_str(), bytes);
+  }
+  {
+    sz::CompressionCache cache(dir);
+    EXPECT_EQ(cache.find(key), nullptr);
+  }
+  std::filesystem::remove_all(dir);
+}
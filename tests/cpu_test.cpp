@@ -0,0 +1,100 @@
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+
+#ifndef WIN32
+#include <sched.h>
+#endif
+
+#include "sz/cpu.hpp"
+
+#include "gtest/gtest.h"
+
+TEST(cpu, available_cpus) {
+  const size_t n = sz::cpu::available_cpus();
+  EXPECT_GE(n, 1);
+  if (std::thread::hardware_concurrency()) {
+    EXPECT_LE(n, std::thread::hardware_concurrency());
+  }
+}
+
+namespace {
+
+void write_cgroup_file(const std::string& path, const std::string& content) {
+  std::filesystem::create_directories(
+      std::filesystem::path(path).parent_path());
+  std::ofstream(path) << content << "\n";
+}
+
+}  // namespace
+
+TEST(cpu, cgroup_cpus) {
+  const std::string root = "cpu_test_cgroup";
+  std::filesystem::remove_all(root);
+  using sz::cpu::cgroup_cpus;
+
+  // cgroup v2 without a quota, and with a quota of 1.5 CPUs.
+  write_cgroup_file(root + "/cpu.max", "max 100000");
+  EXPECT_EQ(cgroup_cpus("0::/\n", root), 0);
+  write_cgroup_file(root + "/cpu.max", "150000 100000");
+  EXPECT_EQ(cgroup_cpus("0::/\n", root), 2);
+
+  // The smallest quota of the ancestors applies.
+  write_cgroup_file(root + "/cpu.max", "max 100000");
+  write_cgroup_file(root + "/a/cpu.max", "300000 100000");
+  write_cgroup_file(root + "/a/b/cpu.max", "max 100000");
+  write_cgroup_file(root + "/a/b/c/cpu.max", "800000 100000");
+  EXPECT_EQ(cgroup_cpus("0::/a/b/c\n", root), 3);
+  // A path without a '/' ends the walk up the ancestors.
+  EXPECT_EQ(cgroup_cpus("0::a\n", root), 0);
+
+  // cgroup v1, at the path of the process or at the root of the hierarchy.
+  write_cgroup_file(root + "/cpu,cpuacct/docker/x/cpu.cfs_quota_us", "-1");
+  write_cgroup_file(root + "/cpu,cpuacct/docker/x/cpu.cfs_period_us",
+                    "100000");
+  EXPECT_EQ(cgroup_cpus("5:cpuset:/\n4:cpu,cpuacct:/docker/x\n", root), 0);
+  write_cgroup_file(root + "/cpu,cpuacct/docker/x/cpu.cfs_quota_us",
+                    "250000");
+  EXPECT_EQ(cgroup_cpus("5:cpuset:/\n4:cpu,cpuacct:/docker/x\n", root), 3);
+  write_cgroup_file(root + "/cpu/cpu.cfs_quota_us", "50000");
+  write_cgroup_file(root + "/cpu/cpu.cfs_period_us", "100000");
+  EXPECT_EQ(cgroup_cpus("4:cpu:/docker/y\n", root), 1);
+
+  EXPECT_EQ(cgroup_cpus("", root), 0);
+  EXPECT_EQ(cgroup_cpus("0::/\n", root + "/missing"), 0);
+  std::filesystem::remove_all(root);
+}
+
+#ifndef WIN32
+TEST(cpu, pin_thread) {
+  cpu_set_t process;
+  ASSERT_EQ(sched_getaffinity(0, sizeof(process), &process), 0);
+  const int n_process = CPU_COUNT(&process);
+
+  // Pinning only affects the calling thread.
+  std::thread([n_process] {
+    ASSERT_TRUE(sz::cpu::pin_thread(n_process + 1));
+    cpu_set_t set;
+    ASSERT_EQ(sched_getaffinity(0, sizeof(set), &set), 0);
+    EXPECT_EQ(CPU_COUNT(&set), 1);
+  }).join();
+
+  cpu_set_t after;
+  ASSERT_EQ(sched_getaffinity(0, sizeof(after), &after), 0);
+  EXPECT_EQ(CPU_COUNT(&after), n_process);
+}
+#endif
+
+TEST(cpu, isa) {
+  using sz::cpu::Isa;
+  for (const Isa isa : {Isa::generic, Isa::sse2, Isa::avx2, Isa::avx512}) {
+    Isa parsed = Isa::generic;
+    ASSERT_TRUE(sz::cpu::parse_isa(sz::cpu::isa_name(isa), parsed));
+    EXPECT_EQ(parsed, isa);
+  }
+  Isa parsed = Isa::avx2;
+  EXPECT_FALSE(sz::cpu::parse_isa("sse5", parsed));
+  EXPECT_EQ(parsed, Isa::avx2);
+  EXPECT_LE(sz::cpu::active_isa(), sz::cpu::detected_isa());
+}
@@ -1,6 +1,12 @@
+#include <algorithm>
 #include <fstream>
+#include <sstream>
+#include <thread>
+#include <vector>
 
 #include "compress/cps_deflate.hpp"
+#include "compress/cps_store.hpp"
+#include "compress/dps_inflate.hpp"
 
 #include "gtest/gtest.h"
 
@@ -103,3 +109,157 @@ TEST_P(RunLengthCodeTest, encode_decode) {
 
 INSTANTIATE_TEST_CASE_P(DeflateTest, RunLengthCodeTest,
                         testing::Values(100, 1000, 10000, 100000));
+
+TEST(deflate, block_stats) {
+  // Two blocks: a compressible one and a random one that is stored.
+  std::vector<sz::Byte> src(sz::DeflateBlockSize * 2);
+  for (size_t i = 0; i < sz::DeflateBlockSize; ++i) {
+    src[i] = static_cast<sz::Byte>('a' + i % 13);
+  }
+  for (size_t i = sz::DeflateBlockSize; i < src.size(); ++i) {
+    src[i] = static_cast<sz::Byte>(rand());
+  }
+  sz::DeflateCompressor compressor(sz::DeflateCodingType::dynamic_coding, 2);
+  compressor.feed(src.data(), src.size());
+  const size_t compressed = compressor.compress();
+
+  const auto& blocks = compressor.get_block_stats();
+  ASSERT_EQ(blocks.size(), 2);
+  EXPECT_EQ(blocks[0].type, sz::BlockType::dynamic_coding);
+  EXPECT_EQ(blocks[1].type, sz::BlockType::store);
+  uint64_t bits = 0;
+  for (const auto& block : blocks) {
+    EXPECT_EQ(block.input_bytes, sz::DeflateBlockSize);
+    EXPECT_EQ(block.n_literals + block.match_bytes, block.input_bytes);
+    bits += block.output_bits;
+  }
+  EXPECT_EQ((bits + 7) / 8, compressed);
+  EXPECT_GT(blocks[0].n_matches, 0);
+  EXPECT_GT(blocks[0].chain_steps, 0);
+
+  std::ostringstream csv;
+  sz::write_stats_csv(
+      csv, {sz::EntryStats{"a,b", sz::CompressionMethod::deflate, src.size(),
+                           compressed, 0.5, false, blocks}});
+  std::string line;
+  std::istringstream lines(csv.str());
+  std::getline(lines, line);
+  std::getline(lines, line);
+  EXPECT_EQ(line.rfind("\"a,b\",deflate,", 0), 0);
+  size_t n_lines = 2;
+  while (std::getline(lines, line)) {
+    ++n_lines;
+  }
+  EXPECT_EQ(n_lines, 3);
+}
+
+TEST(deflate, concurrent_options) {
+  std::vector<sz::Byte> src(sz::DeflateBlockSize * 3);
+  for (size_t i = 0; i < src.size(); ++i) {
+    src[i] = static_cast<sz::Byte>('a' + rand() % 8);
+  }
+  const auto compress = [&src](const sz::CompressionOptions& options) {
+    sz::DeflateCompressor compressor(options, 2);
+    compressor.feed(src.data(), src.size());
+    std::vector<sz::Byte> dst(compressor.compress());
+    compressor.write_result(dst.data());
+    return dst;
+  };
+
+  std::vector<sz::CompressionOptions> options(2);
+  options[0].lz77_level = 0;
+  options[1].lz77_level = 3;
+  options[1].use_static = true;
+  std::vector<std::vector<sz::Byte>> expected;
+  for (const auto& opt : options) {
+    expected.push_back(compress(opt));
+  }
+  EXPECT_NE(expected[0], expected[1]);
+
+  // Compressors with different options do not affect each other.
+  std::vector<std::vector<sz::Byte>> results(options.size());
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < options.size(); ++i) {
+    threads.emplace_back([&, i] { results[i] = compress(options[i]); });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(results, expected);
+}
+
+namespace {
+
+// Push src into the stream of compressor in chunks of uneven sizes, including
+// empty ones, and return the compressed content.
+std::vector<sz::Byte> compress_stream(sz::Compressor& compressor,
+                                      const std::vector<sz::Byte>& src,
+                                      const sz::DeflateCompressor* deflate) {
+  std::vector<sz::Byte> res;
+  compressor.begin([&res](const sz::Byte* data, size_t n) {
+    res.insert(res.end(), data, data + n);
+  });
+  const size_t chunks[] = {1, 0, 4093, sz::DeflateBlockSize + 7, 65536};
+  for (size_t i = 0, k = 0; i < src.size(); ++k) {
+    const size_t n = std::min(chunks[k % 5], src.size() - i);
+    compressor.push(src.data() + i, n);
+    i += n;
+    if (deflate) {
+      EXPECT_LE(deflate->get_pending_size(),
+                deflate->get_stream_workers() * sz::DeflateBlockSize + 1);
+    }
+  }
+  const size_t n = compressor.finish();
+  EXPECT_EQ(n, res.size());
+  return res;
+}
+
+}  // namespace
+
+TEST(deflate, stream) {
+  const size_t batch = 2 * sz::DeflateBlockSize;
+  // Empty content, a partial block, a whole batch, a batch and a one byte
+  // tail, and several batches and a short tail.
+  for (size_t n : {static_cast<size_t>(0), static_cast<size_t>(1000), batch,
+                   batch + 1, 2 * batch + 3}) {
+    std::vector<sz::Byte> src(n);
+    for (size_t i = 0; i < n; ++i) {
+      src[i] = static_cast<sz::Byte>('a' + rand() % 6 + (i >> 16) % 3);
+    }
+
+    sz::DeflateCompressor compressor(sz::DeflateCodingType::dynamic_coding, 2);
+    const auto streamed = compress_stream(compressor, src, &compressor);
+    EXPECT_EQ(compressor.get_stream_workers(), 2);
+    EXPECT_EQ(compressor.get_pending_size(), 0);
+
+    // compress() merges a tail shorter than a block into the previous block,
+    // which the stream cannot do within its pending content, so the outputs
+    // only match if the content is cut into the same blocks.
+    compressor.feed(src.data(), src.size());
+    std::vector<sz::Byte> expected(compressor.compress());
+    compressor.write_result(expected.data());
+    if (n <= sz::DeflateBlockSize || n % sz::DeflateBlockSize == 0) {
+      EXPECT_EQ(streamed, expected);
+    } else {
+      EXPECT_NE(streamed, expected);
+    }
+
+    sz::InflateDecoder decoder;
+    std::vector<sz::Byte> dst(n);
+    EXPECT_TRUE(decoder.decompress(streamed.data(), streamed.size(),
+                                   dst.data(), dst.size()));
+    EXPECT_EQ(dst, src);
+  }
+}
+
+TEST(store, stream) {
+  for (size_t n : {static_cast<size_t>(0), static_cast<size_t>(1000),
+                   sz::DeflateBlockSize * 2 + 1}) {
+    std::vector<sz::Byte> src(n);
+    for (size_t i = 0; i < n; ++i) {
+      src[i] = static_cast<sz::Byte>(rand());
+    }
+    sz::StoreCompressor compressor;
+    EXPECT_EQ(compress_stream(compressor, src, nullptr), src);
+  }
+}
@@ -0,0 +1,216 @@
+#include <algorithm>
+#include <vector>
+
+#include "compress/cps_deflate.hpp"
+#include "compress/dps_inflate.hpp"
+#include "compress/dps_store.hpp"
+
+#include "gtest/gtest.h"
+
+namespace {
+
+enum class Corpus { random, text, zeros };
+
+std::vector<sz::Byte> make_corpus(Corpus corpus, size_t n) {
+  std::vector<sz::Byte> src(n);
+  for (size_t i = 0; i < n; ++i) {
+    switch (corpus) {
+      case Corpus::random:
+        src[i] = static_cast<sz::Byte>(rand());
+        break;
+      case Corpus::text:
+        src[i] = static_cast<sz::Byte>('a' + rand() % 6 + (i / 1000) % 3);
+        break;
+      case Corpus::zeros:
+        src[i] = 0;
+        break;
+    }
+  }
+  return src;
+}
+
+std::vector<sz::Byte> deflate(const std::vector<sz::Byte>& src,
+                              sz::DeflateCodingType coding_type) {
+  sz::DeflateCompressor compressor(coding_type, 2);
+  compressor.feed(src.data(), src.size());
+  std::vector<sz::Byte> res(compressor.compress());
+  compressor.write_result(res.data());
+  return res;
+}
+
+std::vector<sz::Byte> inflate_stream(const std::vector<sz::Byte>& src,
+                                     size_t chunk, bool& ok) {
+  std::vector<sz::Byte> res;
+  sz::InflateDecoder decoder;
+  decoder.begin([&res](const sz::Byte* data, size_t n) {
+    res.insert(res.end(), data, data + n);
+  });
+  ok = true;
+  for (size_t i = 0; i < src.size() && ok; i += chunk) {
+    ok = decoder.push(src.data() + i, std::min(chunk, src.size() - i));
+  }
+  ok = decoder.finish() && ok;
+  return res;
+}
+
+}  // namespace
+
+class InflateTest
+    : public testing::TestWithParam<std::tuple<Corpus, sz::DeflateCodingType>> {
+};
+
+TEST_P(InflateTest, roundtrip) {
+  const auto [corpus, coding_type] = GetParam();
+  for (size_t n : {static_cast<size_t>(0), static_cast<size_t>(1000),
+                   sz::DeflateBlockSize * 5 / 2}) {
+    const auto src = make_corpus(corpus, n);
+    const auto compressed = deflate(src, coding_type);
+
+    sz::InflateDecoder decoder;
+    std::vector<sz::Byte> dst(n);
+    EXPECT_TRUE(decoder.decompress(compressed.data(), compressed.size(),
+                                   dst.data(), dst.size()));
+    EXPECT_EQ(dst, src);
+
+    for (size_t chunk : {1, 4093, 1 << 20}) {
+      if (chunk == 1 && n > 1000) {
+        continue;
+      }
+      bool ok = false;
+      EXPECT_EQ(inflate_stream(compressed, chunk, ok), src);
+      EXPECT_TRUE(ok);
+    }
+  }
+}
+
+INSTANTIATE_TEST_SUITE_P(
+    Inflate, InflateTest,
+    testing::Combine(testing::Values(Corpus::random, Corpus::text,
+                                     Corpus::zeros),
+                     testing::Values(sz::DeflateCodingType::static_coding,
+                                     sz::DeflateCodingType::dynamic_coding)));
+
+TEST(inflate, zlib_stream) {
+  // Raw deflate of "SimpleZip inflate test: ", "abc" * 80 and bytes 0..255,
+  // produced by zlib at level 9.
+  const std::vector<sz::Byte> compressed = {
+      0x0b, 0xce, 0xcc, 0x2d, 0xc8, 0x49, 0x8d, 0xca, 0x2c, 0x50, 0xc8, 0xcc,
+      0x4b, 0xcb, 0x49, 0x2c, 0x49, 0x55, 0x28, 0x49, 0x2d, 0x2e, 0xb1, 0x52,
+      0x48, 0x4c, 0x4a, 0x1e, 0x51, 0x88, 0x81, 0x91, 0x89, 0x99, 0x85, 0x95,
+      0x8d, 0x9d, 0x83, 0x93, 0x8b, 0x9b, 0x87, 0x97, 0x8f, 0x5f, 0x40, 0x50,
+      0x48, 0x58, 0x44, 0x54, 0x4c, 0x5c, 0x42, 0x52, 0x4a, 0x5a, 0x46, 0x56,
+      0x4e, 0x5e, 0x41, 0x51, 0x49, 0x59, 0x45, 0x55, 0x4d, 0x5d, 0x43, 0x53,
+      0x4b, 0x5b, 0x47, 0x57, 0x4f, 0xdf, 0xc0, 0xd0, 0xc8, 0xd8, 0xc4, 0xd4,
+      0xcc, 0xdc, 0xc2, 0xd2, 0xca, 0xda, 0xc6, 0xd6, 0xce, 0xde, 0xc1, 0xd1,
+      0xc9, 0xd9, 0xc5, 0xd5, 0xcd, 0xdd, 0xc3, 0xd3, 0xcb, 0xdb, 0xc7, 0xd7,
+      0xcf, 0x3f, 0x20, 0x30, 0x28, 0x38, 0x24, 0x34, 0x2c, 0x3c, 0x22, 0x32,
+      0x2a, 0x3a, 0x26, 0x36, 0x2e, 0x3e, 0x01, 0x68, 0x47, 0x4a, 0x6a, 0x5a,
+      0x7a, 0x46, 0x66, 0x56, 0x76, 0x4e, 0x6e, 0x5e, 0x7e, 0x41, 0x61, 0x51,
+      0x71, 0x49, 0x69, 0x59, 0x79, 0x45, 0x65, 0x55, 0x75, 0x4d, 0x6d, 0x5d,
+      0x7d, 0x43, 0x63, 0x53, 0x73, 0x4b, 0x6b, 0x5b, 0x7b, 0x47, 0x67, 0x57,
+      0x77, 0x4f, 0x6f, 0x5f, 0xff, 0x84, 0x89, 0x93, 0x26, 0x4f, 0x99, 0x3a,
+      0x6d, 0xfa, 0x8c, 0x99, 0xb3, 0x66, 0xcf, 0x99, 0x3b, 0x6f, 0xfe, 0x82,
+      0x85, 0x8b, 0x16, 0x2f, 0x59, 0xba, 0x6c, 0xf9, 0x8a, 0x95, 0xab, 0x56,
+      0xaf, 0x59, 0xbb, 0x6e, 0xfd, 0x86, 0x8d, 0x9b, 0x36, 0x6f, 0xd9, 0xba,
+      0x6d, 0xfb, 0x8e, 0x9d, 0xbb, 0x76, 0xef, 0xd9, 0xbb, 0x6f, 0xff, 0x81,
+      0x83, 0x87, 0x0e, 0x1f, 0x39, 0x7a, 0xec, 0xf8, 0x89, 0x93, 0xa7, 0x4e,
+      0x9f, 0x39, 0x7b, 0xee, 0xfc, 0x85, 0x8b, 0x97, 0x2e, 0x5f, 0xb9, 0x7a,
+      0xed, 0xfa, 0x8d, 0x9b, 0xb7, 0x6e, 0xdf, 0xb9, 0x7b, 0xef, 0xfe, 0x83,
+      0x87, 0x8f, 0x1e, 0x3f, 0x79, 0xfa, 0xec, 0xf9, 0x8b, 0x97, 0xaf, 0x5e,
+      0xbf, 0x79, 0xfb, 0xee, 0xfd, 0x87, 0x8f, 0x9f, 0x3e, 0x7f, 0xf9, 0xfa,
+      0xed, 0xfb, 0x8f, 0x9f, 0xbf, 0x7e, 0xff, 0xf9, 0xfb, 0xef, 0x3f, 0x00};
+  std::string expected = "SimpleZip inflate test: ";
+  for (int i = 0; i < 80; ++i) {
+    expected += "abc";
+  }
+  for (int i = 0; i < 256; ++i) {
+    expected += static_cast<char>(i);
+  }
+
+  sz::InflateDecoder decoder;
+  std::vector<sz::Byte> dst(expected.size());
+  ASSERT_TRUE(decoder.decompress(compressed.data(), compressed.size(),
+                                 dst.data(), dst.size()));
+  EXPECT_EQ(std::string(dst.begin(), dst.end()), expected);
+}
+
+TEST(inflate, corrupted) {
+  const auto src = make_corpus(Corpus::text, 100000);
+  const auto compressed =
+      deflate(src, sz::DeflateCodingType::dynamic_coding);
+  sz::InflateDecoder decoder;
+  std::vector<sz::Byte> dst(src.size());
+
+  // Truncated content.
+  EXPECT_FALSE(decoder.decompress(compressed.data(), compressed.size() / 2,
+                                  dst.data(), dst.size()));
+  bool ok = true;
+  const std::vector<sz::Byte> truncated(
+      compressed.begin(), compressed.begin() + compressed.size() / 2);
+  (void)inflate_stream(truncated, 4096, ok);
+  EXPECT_FALSE(ok);
+
+  // Wrong length of destination.
+  dst.resize(src.size() - 1);
+  EXPECT_FALSE(decoder.decompress(compressed.data(), compressed.size(),
+                                  dst.data(), dst.size()));
+  dst.resize(src.size() + 1);
+  EXPECT_FALSE(decoder.decompress(compressed.data(), compressed.size(),
+                                  dst.data(), dst.size()));
+
+  // Reserved block type.
+  const sz::Byte reserved[] = {0x07, 0x00};
+  EXPECT_FALSE(decoder.decompress(reserved, 2, dst.data(), dst.size()));
+}
+
+TEST(inflate, store) {
+  const auto src = make_corpus(Corpus::random, 5000);
+  sz::StoreDecoder decoder;
+  std::vector<sz::Byte> dst(src.size());
+  EXPECT_TRUE(decoder.decompress(src.data(), src.size(), dst.data(),
+                                 dst.size()));
+  EXPECT_EQ(dst, src);
+}
+
+TEST(inflate, sync_sections) {
+  // Random blocks end with store blocks, text blocks with huffman blocks.
+  auto src = make_corpus(Corpus::text, 5 * sz::DeflateBlockSize + 1234);
+  const auto random = make_corpus(Corpus::random, sz::DeflateBlockSize);
+  std::copy(random.begin(), random.end(), src.begin() + sz::DeflateBlockSize);
+
+  sz::DeflateCompressor compressor(sz::DeflateCodingType::dynamic_coding, 3);
+  compressor.set_sync_sections(true);
+  compressor.feed(src.data(), src.size());
+  std::vector<sz::Byte> res(compressor.compress());
+  compressor.write_result(res.data());
+  const auto& sections = compressor.get_sections();
+  ASSERT_EQ(sections.size(), 5);
+
+  // Still a single deflate stream.
+  std::vector<sz::Byte> dst(src.size());
+  sz::InflateDecoder decoder;
+  EXPECT_TRUE(decoder.decompress(res.data(), res.size(), dst.data(),
+                                 dst.size()));
+  EXPECT_EQ(dst, src);
+
+  // Each section is decoded on its own.
+  std::fill(dst.begin(), dst.end(), 0);
+  size_t off_compressed = 0;
+  size_t off_uncompressed = 0;
+  for (size_t i = 0; i < sections.size(); ++i) {
+    EXPECT_TRUE(decoder.decompress_section(
+        res.data() + off_compressed, sections[i].compressed_len,
+        dst.data() + off_uncompressed, sections[i].uncompressed_len,
+        i + 1 == sections.size()));
+    off_compressed += sections[i].compressed_len;
+    off_uncompressed += sections[i].uncompressed_len;
+  }
+  EXPECT_EQ(off_compressed, res.size());
+  EXPECT_EQ(dst, src);
+
+  // A section that is not the last one does not end the stream.
+  EXPECT_FALSE(decoder.decompress_section(res.data(),
+                                          sections[0].compressed_len,
+                                          dst.data(),
+                                          sections[0].uncompressed_len, true));
+}
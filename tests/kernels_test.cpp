@@ -0,0 +1,56 @@
+#include <cstdlib>
+#include <vector>
+
+#include "util/kernels.hpp"
+
+#include "gtest/gtest.h"
+
+namespace {
+
+size_t match_length_reference(const sz::Byte* a, const sz::Byte* b,
+                              const size_t n) {
+  size_t i = 0;
+  while (i < n && a[i] == b[i]) {
+    ++i;
+  }
+  return i;
+}
+
+}  // namespace
+
+TEST(kernels, active) {
+  EXPECT_EQ(sz::kernels::active().isa, sz::cpu::active_isa());
+}
+
+// Every variant the CPU can run agrees with the plain loop, for lengths and
+// mismatch positions around the vector widths.
+TEST(kernels, match_length) {
+  using sz::cpu::Isa;
+  std::vector<sz::Byte> a(300);
+  for (auto& byte : a) {
+    byte = static_cast<sz::Byte>(rand());
+  }
+  for (const Isa isa : {Isa::generic, Isa::sse2, Isa::avx2, Isa::avx512}) {
+    if (isa > sz::cpu::detected_isa()) {
+      break;
+    }
+    const auto match_length = sz::kernels::table(isa).match_length;
+    SCOPED_TRACE(sz::cpu::isa_name(isa));
+    for (size_t n = 0; n <= 258; ++n) {
+      for (const size_t diff : {size_t{0}, size_t{1}, size_t{15}, size_t{16},
+                                size_t{31}, size_t{32}, size_t{63},
+                                size_t{64}, n / 2, n, n + 1}) {
+        // b is a copy of a, offset by 1 to also cover unaligned loads, with
+        // a mismatch at diff. Nothing past n must be compared.
+        std::vector<sz::Byte> b(a.begin(), a.begin() + n + 1);
+        b.insert(b.begin(), 0);
+        if (diff < b.size() - 1) {
+          b[diff + 1] ^= 0x5A;
+        }
+        ASSERT_EQ(match_length(a.data(), b.data() + 1, n),
+                  match_length_reference(a.data(), b.data() + 1, n))
+            << "n = " << n << ", diff = " << diff;
+      }
+    }
+  }
+}
@@ -0,0 +1,68 @@
+#include <vector>
+
+#include "sz/memory.hpp"
+
+#include "compress/cps_deflate.hpp"
+
+#include "gtest/gtest.h"
+
+TEST(memory, charges) {
+  using sz::memory::Use;
+  const sz::memory::Report before = sz::memory::report();
+  const auto source = static_cast<size_t>(Use::source);
+  sz::memory::reset_peaks();
+  {
+    sz::memory::Charge a(Use::source, 1000);
+    sz::memory::Charge b = a;
+    EXPECT_EQ(sz::memory::report().current[source],
+              before.current[source] + 2000);
+    sz::memory::Charge c = std::move(b);
+    EXPECT_EQ(c.bytes(), 1000);
+    EXPECT_EQ(sz::memory::report().current[source],
+              before.current[source] + 2000);
+    a.set(100);
+    c.set(3000);
+  }
+  const sz::memory::Report after = sz::memory::report();
+  EXPECT_EQ(after.current[source], before.current[source]);
+  EXPECT_EQ(after.peak[source], before.current[source] + 3100);
+  EXPECT_GE(after.peak_total, before.current_total + 3100);
+}
+
+TEST(memory, fit_workers) {
+  EXPECT_EQ(sz::memory::fit_workers(8, 1 << 20), 8);
+  const sz::uint64 used = sz::memory::report().current_total;
+  sz::memory::set_budget(used + (3 << 20) + 1);
+  EXPECT_EQ(sz::memory::fit_workers(8, 1 << 20), 3);
+  EXPECT_EQ(sz::memory::fit_workers(2, 1 << 20), 2);
+  // A single worker runs even if it does not fit.
+  sz::memory::set_budget(1);
+  EXPECT_EQ(sz::memory::fit_workers(8, 1 << 20), 1);
+  sz::memory::set_budget(0);
+}
+
+TEST(memory, deflate_within_budget) {
+  std::vector<sz::Byte> src(sz::DeflateBlockSize * 4);
+  for (size_t i = 0; i < src.size(); ++i) {
+    src[i] = static_cast<sz::Byte>('a' + i * 7 % 13);
+  }
+  const auto lz77 = static_cast<size_t>(sz::memory::Use::lz77);
+  const sz::uint64 worker = sz::DeflateCompressor::worker_memory();
+
+  // Two workers fit in the budget, so at most two dictionaries are alive.
+  sz::memory::reset_peaks();
+  const sz::uint64 used = sz::memory::report().current_total;
+  sz::memory::set_budget(used + 2 * worker + worker / 2);
+  {
+    sz::DeflateCompressor compressor(sz::DeflateCodingType::dynamic_coding, 4);
+    compressor.feed(src.data(), src.size());
+    (void)compressor.compress();
+  }
+  sz::memory::set_budget(0);
+  const sz::memory::Report report = sz::memory::report();
+  EXPECT_GT(report.peak[lz77], sizeof(sz::LZ77Dictionary));
+  EXPECT_LE(report.peak[lz77], 2 * worker);
+  EXPECT_GT(report.peak[lz77], worker / 2);
+  // Everything is released with the compressor.
+  EXPECT_EQ(report.current_total, used);
+}
@@ -0,0 +1,40 @@
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "util/progress_bar.hpp"
+
+#include "gtest/gtest.h"
+
+TEST(progress_bar, concurrent_progress) {
+  std::ostringstream os;
+  {
+    sz::ProgressBar bar("test: ", &os, 4000, 10, ' ', '=', '>');
+    bar.set_display(true);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+      threads.emplace_back([&bar] {
+        for (int i = 0; i < 1000; ++i) {
+          bar.increase_progress(1);
+        }
+      });
+    }
+    for (auto&& thread : threads) {
+      thread.join();
+    }
+    // The last drawing shows exactly the progress made, without set_full().
+    bar.set_display(false);
+  }
+  const std::string out = os.str();
+  EXPECT_EQ(out.rfind("test: ", 0), 0);
+  EXPECT_NE(out.find("test:  [==========] 100 %"), std::string::npos);
+
+  // A bar never displayed neither counts nor draws.
+  std::ostringstream hidden;
+  {
+    sz::ProgressBar bar("test: ", &hidden, 100, 10, ' ', '=', '>');
+    bar.increase_progress(50);
+  }
+  EXPECT_TRUE(hidden.str().empty());
+}
@@ -0,0 +1,97 @@
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "sz/trace.hpp"
+
+#include "compress/cps_deflate.hpp"
+
+#include "gtest/gtest.h"
+
+namespace {
+
+size_t count(const std::string& s, const std::string& pattern) {
+  size_t n = 0;
+  for (size_t i = s.find(pattern); i != std::string::npos;
+       i = s.find(pattern, i + 1)) {
+    ++n;
+  }
+  return n;
+}
+
+}  // namespace
+
+#ifndef SZ_DISABLE_TRACE
+TEST(trace, deflate_timeline) {
+  std::vector<sz::Byte> src(sz::DeflateBlockSize * 3);
+  for (size_t i = 0; i < src.size(); ++i) {
+    src[i] = static_cast<sz::Byte>('a' + i % 11);
+  }
+
+  // Spans are not recorded before tracing is enabled.
+  { sz::trace::Span span("trace_test::ignored"); }
+  sz::trace::enable();
+  {
+    sz::DeflateCompressor compressor(sz::DeflateCodingType::dynamic_coding, 3);
+    compressor.feed(src.data(), src.size());
+    (void)compressor.compress();
+  }
+  sz::trace::disable();
+  { sz::trace::Span span("trace_test::ignored"); }
+
+  std::ostringstream os;
+  sz::trace::write_json(os);
+  const std::string json = os.str();
+  EXPECT_EQ(json.rfind("{\"traceEvents\":[", 0), 0);
+  EXPECT_EQ(count(json, "\"name\":\"deflate::compress\""), 1);
+  EXPECT_EQ(count(json, "\"name\":\"deflate::block\""), 3);
+  EXPECT_EQ(count(json, "\"name\":\"deflate::lz77\""), 3);
+  EXPECT_EQ(count(json, "\"name\":\"deflate::huffman\""), 3);
+  EXPECT_EQ(count(json, "trace_test::ignored"), 0);
+  // The compressing thread and the three workers, at most. A worker that
+  // starts after another has exited takes over its lane.
+  EXPECT_GT(count(json, "\"tid\":1,"), 0);
+  EXPECT_GT(count(json, "\"tid\":2,"), 0);
+  EXPECT_EQ(count(json, "\"tid\":5,"), 0);
+  EXPECT_EQ(count(json, "\"args\":{\"bytes\":" +
+                            std::to_string(sz::DeflateBlockSize) + "}"),
+            9);
+
+  // enable() drops the events of the last recording.
+  sz::trace::enable();
+  sz::trace::disable();
+  std::ostringstream empty;
+  sz::trace::write_json(empty);
+  EXPECT_EQ(count(empty.str(), "\"ph\":\"X\""), 0);
+}
+
+TEST(trace, reuse_lanes) {
+  // Threads started one after the other record on one lane.
+  sz::trace::enable();
+  for (int i = 0; i < 5; ++i) {
+    std::thread([] { sz::trace::Span span("trace_test::batch"); }).join();
+  }
+  sz::trace::disable();
+
+  std::ostringstream os;
+  sz::trace::write_json(os);
+  std::istringstream lines(os.str());
+  std::string tid;
+  size_t n = 0;
+  for (std::string line; std::getline(lines, line);) {
+    if (line.find("trace_test::batch") == std::string::npos) {
+      continue;
+    }
+    const size_t begin = line.find("\"tid\":");
+    const std::string line_tid =
+        line.substr(begin, line.find(',', begin) - begin);
+    if (tid.empty()) {
+      tid = line_tid;
+    }
+    EXPECT_EQ(line_tid, tid);
+    ++n;
+  }
+  EXPECT_EQ(n, 5);
+}
+#endif
@@ -0,0 +1,181 @@
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "sz/unzipper.hpp"
+#include "sz/zip_reader.hpp"
+#include "sz/zipper.hpp"
+
+#include "util/fs.hpp"
+#include "wrapper/version.hpp"
+#include "wrapper/zip_format.hpp"
+
+#include "gtest/gtest.h"
+
+TEST(unzipper, extract_all) {
+  const std::vector<std::string> filenames = {
+      "unzipper_test_text.txt", "unzipper_test_random.bin",
+      "unzipper_test_empty.bin", "unzipper_test_large.txt"};
+  std::vector<std::vector<sz::Byte>> contents(4);
+  for (int i = 0; i < 20000; ++i) {
+    contents[0].push_back(static_cast<sz::Byte>('a' + i % 7));
+  }
+  for (int i = 0; i < 300000; ++i) {
+    contents[1].push_back(static_cast<sz::Byte>(rand()));
+  }
+  // Larger than the buffer of a worker, so that it is written in chunks.
+  for (int i = 0; i < (6 << 20); ++i) {
+    contents[3].push_back(static_cast<sz::Byte>('a' + rand() % 3));
+  }
+
+  sz::Zipper zipper;
+  for (size_t i = 0; i < filenames.size(); ++i) {
+    sz::io::write_bytes(filenames[i].c_str(), contents[i]);
+    zipper.add_entry(
+        sz::FileEntry(filenames[i], sz::CompressionMethod::deflate, 2));
+  }
+  zipper.update_buffer();
+  ASSERT_TRUE(zipper.write("unzipper_test.zip"));
+  for (const auto& filename : filenames) {
+    std::remove(filename.c_str());
+  }
+
+  {
+    sz::ZipReader reader("unzipper_test.zip");
+    ASSERT_TRUE(reader.is_open());
+    const sz::UnzipReport report =
+        sz::Unzipper(reader, 3).extract({}, "unzipper_test_out");
+    EXPECT_TRUE(report.failures.empty());
+    EXPECT_EQ(report.n_entries, filenames.size());
+    for (size_t i = 0; i < filenames.size(); ++i) {
+      EXPECT_EQ(
+          sz::io::read_bytes(("unzipper_test_out/" + filenames[i]).c_str()),
+          contents[i]);
+    }
+
+    const sz::UnzipReport missing = sz::Unzipper(reader, 2).extract(
+        {filenames[0], "unzipper_test_missing.bin"}, "unzipper_test_out");
+    EXPECT_EQ(missing.n_entries, 1);
+    ASSERT_EQ(missing.failures.size(), 1);
+    EXPECT_EQ(missing.failures[0], "unzipper_test_missing.bin");
+  }
+
+  std::filesystem::remove_all("unzipper_test_out");
+  std::remove("unzipper_test.zip");
+}
+
+TEST(unzipper, refuse_unsafe_names) {
+  std::vector<sz::Byte> buffer;
+  std::vector<sz::EntryRecord> records;
+  for (const char* name : {"../unzipper_test_escape", "/unzipper_test_abs",
+                           "unzipper_test_safe/"}) {
+    records.push_back(sz::EntryRecord{sz::Version,
+                                      sz::ExtractVersion,
+                                      0,
+                                      sz::CompressionMethod::none,
+                                      sz::Timestamp{0, 0},
+                                      0,
+                                      0,
+                                      0,
+                                      0,
+                                      0,
+                                      0,
+                                      buffer.size(),
+                                      name,
+                                      "",
+                                      false,
+                                      {}});
+    sz::write_local_file_header(buffer, records.back());
+  }
+  const size_t off_cd = buffer.size();
+  for (const auto& record : records) {
+    sz::write_central_directory_file_header(buffer, record);
+  }
+  sz::write_eocd(buffer, records.size(), off_cd, buffer.size() - off_cd, "");
+  sz::io::write_bytes("unzipper_test_unsafe.zip", buffer);
+
+  {
+    sz::ZipReader reader("unzipper_test_unsafe.zip");
+    ASSERT_TRUE(reader.is_open());
+    const sz::UnzipReport report =
+        sz::Unzipper(reader, 2).extract({}, "unzipper_test_unsafe");
+    EXPECT_EQ(report.n_entries, 1);
+    EXPECT_EQ(report.failures.size(), 2);
+    EXPECT_TRUE(std::filesystem::is_directory(
+        "unzipper_test_unsafe/unzipper_test_safe"));
+    EXPECT_FALSE(std::filesystem::exists("unzipper_test_escape"));
+  }
+
+  std::filesystem::remove_all("unzipper_test_unsafe");
+  std::remove("unzipper_test_unsafe.zip");
+}
+
+TEST(unzipper, test_entries) {
+  const std::string filename = "unzipper_test_verify.txt";
+  std::vector<sz::Byte> content;
+  for (int i = 0; i < 200000; ++i) {
+    content.push_back(static_cast<sz::Byte>('a' + rand() % 5));
+  }
+  sz::io::write_bytes(filename.c_str(), content);
+  sz::Zipper zipper;
+  zipper.add_entry(sz::FileEntry(filename, sz::CompressionMethod::none, 2));
+  zipper.add_entry(sz::FileEntry(filename, sz::CompressionMethod::deflate, 2));
+  zipper.update_buffer();
+  ASSERT_TRUE(zipper.write("unzipper_test_verify.zip"));
+  std::remove(filename.c_str());
+
+  {
+    sz::ZipReader reader("unzipper_test_verify.zip");
+    ASSERT_TRUE(reader.is_open());
+    const sz::UnzipReport report = sz::Unzipper(reader, 2).test({});
+    EXPECT_TRUE(report.failures.empty());
+    EXPECT_EQ(report.n_entries, 2);
+    EXPECT_EQ(report.n_bytes, 2 * content.size());
+  }
+
+  // Flip a byte of the stored entry, which is the first one.
+  auto archive = sz::io::read_bytes("unzipper_test_verify.zip");
+  archive[30 + filename.size() + 1000] ^= 0x55;
+  sz::io::write_bytes("unzipper_test_verify.zip", archive);
+  {
+    sz::ZipReader reader("unzipper_test_verify.zip");
+    ASSERT_TRUE(reader.is_open());
+    const sz::UnzipReport report = sz::Unzipper(reader, 2).test({});
+    EXPECT_EQ(report.n_entries, 1);
+    ASSERT_EQ(report.failures.size(), 1);
+    EXPECT_EQ(report.failures[0], filename);
+  }
+  std::remove("unzipper_test_verify.zip");
+}
+
+TEST(unzipper, remove_failed_output) {
+  const std::string filename = "unzipper_test_corrupt.txt";
+  std::vector<sz::Byte> content;
+  for (int i = 0; i < 200000; ++i) {
+    content.push_back(static_cast<sz::Byte>('a' + rand() % 5));
+  }
+  sz::io::write_bytes(filename.c_str(), content);
+  sz::Zipper zipper;
+  zipper.add_entry(sz::FileEntry(filename, sz::CompressionMethod::none, 2));
+  zipper.update_buffer();
+  ASSERT_TRUE(zipper.write("unzipper_test_corrupt.zip"));
+  std::remove(filename.c_str());
+
+  auto archive = sz::io::read_bytes("unzipper_test_corrupt.zip");
+  archive[30 + filename.size() + 1000] ^= 0x55;
+  sz::io::write_bytes("unzipper_test_corrupt.zip", archive);
+  {
+    sz::ZipReader reader("unzipper_test_corrupt.zip");
+    ASSERT_TRUE(reader.is_open());
+    const sz::UnzipReport report =
+        sz::Unzipper(reader, 2).extract({}, "unzipper_test_corrupt");
+    EXPECT_EQ(report.n_entries, 0);
+    ASSERT_EQ(report.failures.size(), 1);
+    // The corrupt content is not left behind.
+    EXPECT_FALSE(std::filesystem::exists("unzipper_test_corrupt/" + filename));
+  }
+
+  std::filesystem::remove_all("unzipper_test_corrupt");
+  std::remove("unzipper_test_corrupt.zip");
+}
@@ -0,0 +1,160 @@
+#include <vector>
+
+#include "util/byte_util.hpp"
+#include "wrapper/constants.hpp"
+#include "wrapper/version.hpp"
+#include "wrapper/zip_format.hpp"
+
+#include "gtest/gtest.h"
+
+namespace {
+
+sz::uint64 read_le(const std::vector<sz::Byte>& buffer, size_t pos, int n) {
+  sz::uint64 res = 0;
+  for (int i = n - 1; i >= 0; --i) {
+    res = res << 8 | buffer[pos + i];
+  }
+  return res;
+}
+
+sz::EntryRecord make_record(sz::SizeType compressed_size,
+                            sz::SizeType uncompressed_size, sz::Offset off) {
+  return sz::EntryRecord{sz::Version,
+                         sz::ExtractVersion,
+                         0,
+                         sz::CompressionMethod::deflate,
+                         sz::Timestamp{0, 0},
+                         0x12345678,
+                         compressed_size,
+                         uncompressed_size,
+                         0,
+                         0,
+                         0,
+                         off,
+                         "a.bin",
+                         "",
+                         false,
+                         {}};
+}
+
+}  // namespace
+
+TEST(zip_format, small_entry_has_no_extra_field) {
+  const auto record = make_record(100, 200, 300);
+  std::vector<sz::Byte> buffer;
+  sz::write_local_file_header(buffer, record);
+  ASSERT_EQ(buffer.size(), 30 + record.filename.length());
+  EXPECT_EQ(read_le(buffer, 4, 2), sz::ExtractVersion);
+  EXPECT_EQ(read_le(buffer, 18, 4), 100);
+  EXPECT_EQ(read_le(buffer, 22, 4), 200);
+  EXPECT_EQ(read_le(buffer, 28, 2), 0);
+
+  buffer.clear();
+  sz::write_central_directory_file_header(buffer, record);
+  ASSERT_EQ(buffer.size(), 46 + record.filename.length());
+  EXPECT_EQ(read_le(buffer, 30, 2), 0);
+  EXPECT_EQ(read_le(buffer, 42, 4), 300);
+
+  buffer.clear();
+  sz::write_eocd(buffer, 0xFFFE, 1000, 2000, "");
+  ASSERT_EQ(buffer.size(), 22);
+  EXPECT_EQ(read_le(buffer, 0, 4),
+            sz::endof_central_directory_file_header_signature);
+  EXPECT_EQ(read_le(buffer, 10, 2), 0xFFFE);
+}
+
+TEST(zip_format, zip64_local_file_header) {
+  const sz::uint64 big = 5ULL << 30;
+  const auto record = make_record(big + 1, big, 0);
+  std::vector<sz::Byte> buffer;
+  sz::write_local_file_header(buffer, record);
+  const size_t name_length = record.filename.length();
+  ASSERT_EQ(buffer.size(), 30 + name_length + 20);
+  EXPECT_EQ(read_le(buffer, 4, 2), sz::Zip64ExtractVersion);
+  EXPECT_EQ(read_le(buffer, 18, 4), 0xFFFFFFFF);
+  EXPECT_EQ(read_le(buffer, 22, 4), 0xFFFFFFFF);
+  EXPECT_EQ(read_le(buffer, 28, 2), 20);
+  const size_t extra = 30 + name_length;
+  EXPECT_EQ(read_le(buffer, extra, 2), sz::Zip64ExtraFieldId);
+  EXPECT_EQ(read_le(buffer, extra + 2, 2), 16);
+  EXPECT_EQ(read_le(buffer, extra + 4, 8), big);
+  EXPECT_EQ(read_le(buffer, extra + 12, 8), big + 1);
+}
+
+TEST(zip_format, zip64_data_descriptor) {
+  auto record = make_record(7, 9, 0);
+  record.general_purpose = sz::GeneralPurposeDataDescriptor;
+  std::vector<sz::Byte> buffer;
+  sz::write_data_descriptor(buffer, record);
+  EXPECT_EQ(buffer.size(), 16);
+
+  // A forced ZIP64 entry has an extra field with zero sizes in its local file
+  // header, and 8-byte sizes in its data descriptor.
+  record.zip64 = true;
+  buffer.clear();
+  sz::write_local_file_header(buffer, record);
+  const size_t extra = 30 + record.filename.length();
+  ASSERT_EQ(buffer.size(), extra + 20);
+  EXPECT_EQ(read_le(buffer, extra + 4, 8), 0);
+  EXPECT_EQ(read_le(buffer, extra + 12, 8), 0);
+
+  buffer.clear();
+  sz::write_data_descriptor(buffer, record);
+  ASSERT_EQ(buffer.size(), 24);
+  EXPECT_EQ(read_le(buffer, 8, 8), 7);
+  EXPECT_EQ(read_le(buffer, 16, 8), 9);
+}
+
+TEST(zip_format, zip64_central_directory_file_header) {
+  const sz::uint64 big = 6ULL << 30;
+  // Only the offset does not fit.
+  auto record = make_record(10, 20, big);
+  std::vector<sz::Byte> buffer;
+  sz::write_central_directory_file_header(buffer, record);
+  const size_t extra = 46 + record.filename.length();
+  ASSERT_EQ(buffer.size(), extra + 12);
+  EXPECT_EQ(read_le(buffer, 6, 2), sz::Zip64ExtractVersion);
+  EXPECT_EQ(read_le(buffer, 20, 4), 10);
+  EXPECT_EQ(read_le(buffer, 24, 4), 20);
+  EXPECT_EQ(read_le(buffer, 42, 4), 0xFFFFFFFF);
+  EXPECT_EQ(read_le(buffer, extra + 2, 2), 8);
+  EXPECT_EQ(read_le(buffer, extra + 4, 8), big);
+
+  // All fields do not fit: uncompressed size, compressed size, offset.
+  record = make_record(big + 1, big + 2, big + 3);
+  buffer.clear();
+  sz::write_central_directory_file_header(buffer, record);
+  ASSERT_EQ(buffer.size(), extra + 28);
+  EXPECT_EQ(read_le(buffer, extra + 4, 8), big + 2);
+  EXPECT_EQ(read_le(buffer, extra + 12, 8), big + 1);
+  EXPECT_EQ(read_le(buffer, extra + 20, 8), big + 3);
+}
+
+TEST(zip_format, zip64_eocd) {
+  const sz::uint64 off_cd = 5ULL << 30;
+  const sz::uint64 len_cd = 4096;
+  std::vector<sz::Byte> buffer(3);
+  sz::write_eocd(buffer, 70000, off_cd, len_cd, "");
+  ASSERT_EQ(buffer.size(), 3 + 56 + 20 + 22);
+
+  EXPECT_EQ(read_le(buffer, 3, 4), sz::zip64_endof_central_directory_signature);
+  EXPECT_EQ(read_le(buffer, 3 + 4, 8), 44);
+  EXPECT_EQ(read_le(buffer, 3 + 24, 8), 70000);
+  EXPECT_EQ(read_le(buffer, 3 + 32, 8), 70000);
+  EXPECT_EQ(read_le(buffer, 3 + 40, 8), len_cd);
+  EXPECT_EQ(read_le(buffer, 3 + 48, 8), off_cd);
+
+  const size_t locator = 3 + 56;
+  EXPECT_EQ(read_le(buffer, locator, 4),
+            sz::zip64_endof_central_directory_locator_signature);
+  EXPECT_EQ(read_le(buffer, locator + 8, 8), off_cd + len_cd);
+  EXPECT_EQ(read_le(buffer, locator + 16, 4), 1);
+
+  const size_t eocd = locator + 20;
+  EXPECT_EQ(read_le(buffer, eocd, 4),
+            sz::endof_central_directory_file_header_signature);
+  EXPECT_EQ(read_le(buffer, eocd + 8, 2), 0xFFFF);
+  EXPECT_EQ(read_le(buffer, eocd + 10, 2), 0xFFFF);
+  EXPECT_EQ(read_le(buffer, eocd + 12, 4), len_cd);
+  EXPECT_EQ(read_le(buffer, eocd + 16, 4), 0xFFFFFFFF);
+}
@@ -0,0 +1,327 @@
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "sz/common.hpp"
+#include "sz/zip_reader.hpp"
+#include "sz/zip_writer.hpp"
+#include "sz/zipper.hpp"
+
+#include "util/fs.hpp"
+#include "wrapper/version.hpp"
+#include "wrapper/zip_format.hpp"
+
+#include "gtest/gtest.h"
+
+TEST(zip_reader, read_zipper_output) {
+  const std::vector<std::string> filenames = {
+      "zip_reader_test_text.txt", "zip_reader_test_random.bin",
+      "zip_reader_test_empty.bin"};
+  std::vector<std::vector<sz::Byte>> contents(3);
+  for (int i = 0; i < 20000; ++i) {
+    contents[0].push_back(static_cast<sz::Byte>('a' + i % 7));
+  }
+  for (int i = 0; i < 300000; ++i) {
+    contents[1].push_back(static_cast<sz::Byte>(rand()));
+  }
+
+  sz::Zipper zipper;
+  for (size_t i = 0; i < filenames.size(); ++i) {
+    sz::io::write_bytes(filenames[i].c_str(), contents[i]);
+    zipper.add_entry(
+        sz::FileEntry(filenames[i], sz::CompressionMethod::deflate, 2));
+  }
+  zipper.update_buffer();
+  ASSERT_TRUE(zipper.write("zip_reader_test.zip"));
+
+  {
+    sz::ZipReader reader("zip_reader_test.zip");
+    ASSERT_TRUE(reader.is_open());
+    EXPECT_EQ(reader.n_entries(), filenames.size());
+    for (size_t i = 0; i < filenames.size(); ++i) {
+      const auto* entry = reader.find(filenames[i]);
+      ASSERT_NE(entry, nullptr);
+      EXPECT_EQ(reader.name(*entry), filenames[i]);
+      ASSERT_EQ(entry->uncompressed_size, contents[i].size());
+      std::vector<sz::Byte> dst(entry->uncompressed_size);
+      EXPECT_TRUE(reader.extract(*entry, dst.data()));
+      EXPECT_EQ(dst, contents[i]);
+    }
+    EXPECT_EQ(reader.find("zip_reader_test_missing.bin"), nullptr);
+    EXPECT_EQ(reader.find(""), nullptr);
+  }
+
+  for (const auto& filename : filenames) {
+    std::remove(filename.c_str());
+  }
+  std::remove("zip_reader_test.zip");
+}
+
+TEST(zip_reader, zip64_eocd) {
+  // More entries than the end of central directory record can count.
+  constexpr size_t n = 70000;
+  std::vector<sz::Byte> buffer;
+  std::vector<sz::EntryRecord> records;
+  for (size_t i = 0; i < n; ++i) {
+    records.push_back(sz::EntryRecord{sz::Version,
+                                      sz::ExtractVersion,
+                                      0,
+                                      sz::CompressionMethod::none,
+                                      sz::Timestamp{0, 0},
+                                      0,
+                                      0,
+                                      0,
+                                      0,
+                                      0,
+                                      0,
+                                      buffer.size(),
+                                      "f/" + std::to_string(i),
+                                      "",
+                                      false,
+                                      {}});
+    sz::write_local_file_header(buffer, records.back());
+  }
+  const size_t off_cd = buffer.size();
+  for (const auto& record : records) {
+    sz::write_central_directory_file_header(buffer, record);
+  }
+  sz::write_eocd(buffer, n, off_cd, buffer.size() - off_cd, "comment");
+  sz::io::write_bytes("zip_reader_test_zip64.zip", buffer);
+
+  {
+    sz::ZipReader reader("zip_reader_test_zip64.zip");
+    ASSERT_TRUE(reader.is_open());
+    EXPECT_EQ(reader.n_entries(), n);
+    for (size_t i : {static_cast<size_t>(0), static_cast<size_t>(12345),
+                     n - 1}) {
+      const auto* entry = reader.find("f/" + std::to_string(i));
+      ASSERT_NE(entry, nullptr);
+      EXPECT_EQ(entry->off_local_file_header,
+                records[i].off_local_file_header);
+      std::vector<sz::Byte> dst;
+      EXPECT_TRUE(reader.extract(*entry, dst.data()));
+    }
+    EXPECT_EQ(reader.find("f/70000"), nullptr);
+  }
+  std::remove("zip_reader_test_zip64.zip");
+}
+
+TEST(zip_reader, not_a_zip) {
+  std::vector<sz::Byte> garbage(1000);
+  for (auto& c : garbage) {
+    c = static_cast<sz::Byte>(rand());
+  }
+  sz::io::write_bytes("zip_reader_test_garbage.zip", garbage);
+  {
+    sz::ZipReader reader("zip_reader_test_garbage.zip");
+    EXPECT_FALSE(reader.is_open());
+    EXPECT_EQ(reader.find("a"), nullptr);
+  }
+  std::remove("zip_reader_test_garbage.zip");
+
+  sz::ZipReader missing("zip_reader_test_does_not_exist.zip");
+  EXPECT_FALSE(missing.is_open());
+}
+
+TEST(zip_reader, extract_parallel) {
+  std::vector<sz::Byte> content;
+  for (int i = 0; i < (5 << 20) + 777; ++i) {
+    content.push_back(static_cast<sz::Byte>('a' + rand() % 4 + (i >> 20)));
+  }
+  sz::io::write_bytes("zip_reader_test_sections.txt", content);
+
+  sz::CompressionOptions options;
+  options.sync_sections = true;
+  sz::Zipper zipper;
+  zipper.add_entry(sz::FileEntry("zip_reader_test_sections.txt",
+                                 sz::CompressionMethod::deflate, 2, options));
+  zipper.update_buffer();
+  ASSERT_TRUE(zipper.write("zip_reader_test_sections.zip"));
+
+  {
+    sz::ZipReader reader("zip_reader_test_sections.zip");
+    ASSERT_TRUE(reader.is_open());
+    const auto* entry = reader.find("zip_reader_test_sections.txt");
+    ASSERT_NE(entry, nullptr);
+    EXPECT_EQ(entry->n_sections, 5);
+
+    std::vector<sz::Byte> dst(entry->uncompressed_size);
+    EXPECT_TRUE(reader.extract_parallel(
+        *entry, 3, [&dst](sz::uint64 off, const sz::Byte* data, size_t n) {
+          std::copy(data, data + n, dst.begin() + off);
+        }));
+    EXPECT_EQ(dst, content);
+
+    // Without the index, the entry is still a plain deflate stream.
+    EXPECT_TRUE(reader.extract(*entry, dst.data()));
+    EXPECT_EQ(dst, content);
+  }
+
+  std::remove("zip_reader_test_sections.txt");
+  std::remove("zip_reader_test_sections.zip");
+}
+
+TEST(zip_reader, read_range) {
+  std::vector<sz::Byte> content;
+  for (int i = 0; i < (4 << 20) + 999; ++i) {
+    content.push_back(static_cast<sz::Byte>('a' + rand() % 4 + (i >> 19)));
+  }
+  sz::io::write_bytes("zip_reader_test_range.txt", content);
+
+  for (const bool sections : {true, false}) {
+    sz::CompressionOptions options;
+    options.sync_sections = sections;
+    sz::Zipper zipper;
+    zipper.add_entry(sz::FileEntry("zip_reader_test_range.txt",
+                                   sz::CompressionMethod::deflate, 2, options));
+    zipper.add_entry(sz::FileEntry("zip_reader_test_range.txt",
+                                   sz::CompressionMethod::none, 2, options));
+    zipper.update_buffer();
+    ASSERT_TRUE(zipper.write("zip_reader_test_range.zip"));
+
+    sz::ZipReader reader("zip_reader_test_range.zip");
+    ASSERT_TRUE(reader.is_open());
+    for (size_t i = 0; i < reader.n_entries(); ++i) {
+      const auto& entry = reader.entry(i);
+      EXPECT_EQ(entry.n_sections,
+                sections && entry.method == sz::CompressionMethod::deflate
+                    ? 4
+                    : 0);
+      const size_t n = content.size();
+      for (const auto& [off, len] :
+           std::vector<std::pair<size_t, size_t>>{{0, 4096},
+                                                  {(1 << 20) - 100, 200},
+                                                  {(3 << 20) + 12345, 4096},
+                                                  {n - 4096, 4096},
+                                                  {n, 0},
+                                                  {0, n}}) {
+        std::vector<sz::Byte> dst(len);
+        ASSERT_TRUE(reader.read(entry, off, len, dst.data()));
+        EXPECT_TRUE(std::equal(dst.begin(), dst.end(), content.begin() + off));
+      }
+      sz::Byte byte;
+      EXPECT_FALSE(reader.read(entry, n, 1, &byte));
+    }
+  }
+
+  std::remove("zip_reader_test_range.txt");
+  std::remove("zip_reader_test_range.zip");
+}
+
+TEST(zip_reader, reuse_entries) {
+  const std::vector<std::string> filenames = {"zip_reader_test_reuse.txt",
+                                              "zip_reader_test_reuse.bin",
+                                              "zip_reader_test_change.txt"};
+  std::vector<std::vector<sz::Byte>> contents(3);
+  for (int i = 0; i < 50000; ++i) {
+    contents[0].push_back(static_cast<sz::Byte>('a' + rand() % 5));
+  }
+  // Large enough to be copied by the kernel.
+  for (int i = 0; i < (3 << 19); ++i) {
+    contents[1].push_back(static_cast<sz::Byte>(rand()));
+  }
+  for (int i = 0; i < 1000; ++i) {
+    contents[2].push_back(static_cast<sz::Byte>('a' + i % 3));
+  }
+  for (size_t i = 0; i < filenames.size(); ++i) {
+    sz::io::write_bytes(filenames[i].c_str(), contents[i]);
+  }
+  {
+    sz::ZipWriter writer("zip_reader_test_old.zip");
+    writer.add_file(filenames[0], sz::CompressionMethod::deflate, 2);
+    writer.add_file(filenames[1], sz::CompressionMethod::none, 2);
+    writer.add_file(filenames[2], sz::CompressionMethod::deflate, 2);
+    ASSERT_TRUE(writer.close());
+  }
+  contents[2].push_back('z');
+  sz::io::write_bytes(filenames[2].c_str(), contents[2]);
+
+  {
+    sz::ZipReader old_reader("zip_reader_test_old.zip");
+    ASSERT_TRUE(old_reader.is_open());
+    sz::ZipWriter writer("zip_reader_test_new.zip");
+    // An entry compressed by another method is not reused.
+    EXPECT_FALSE(writer.reuse_entry(old_reader, filenames[0],
+                                    sz::CompressionMethod::none));
+    EXPECT_FALSE(writer.reuse_entry(old_reader, filenames[1],
+                                    sz::CompressionMethod::deflate));
+    EXPECT_TRUE(writer.reuse_entry(old_reader, filenames[0],
+                                   sz::CompressionMethod::deflate));
+    EXPECT_TRUE(writer.reuse_entry(old_reader, filenames[1],
+                                   sz::CompressionMethod::none));
+    EXPECT_FALSE(writer.reuse_entry(old_reader, filenames[2],
+                                    sz::CompressionMethod::deflate));
+    EXPECT_FALSE(writer.reuse_entry(old_reader, "zip_reader_test_missing",
+                                    sz::CompressionMethod::deflate));
+    writer.add_file(filenames[2], sz::CompressionMethod::deflate, 2);
+    ASSERT_TRUE(writer.close());
+  }
+
+  {
+    sz::ZipReader reader("zip_reader_test_new.zip");
+    ASSERT_TRUE(reader.is_open());
+    ASSERT_EQ(reader.n_entries(), filenames.size());
+    for (size_t i = 0; i < filenames.size(); ++i) {
+      const auto* entry = reader.find(filenames[i]);
+      ASSERT_NE(entry, nullptr);
+      ASSERT_EQ(entry->uncompressed_size, contents[i].size());
+      std::vector<sz::Byte> dst(entry->uncompressed_size);
+      EXPECT_TRUE(reader.extract(*entry, dst.data()));
+      EXPECT_EQ(dst, contents[i]);
+    }
+  }
+
+  for (const auto& filename : filenames) {
+    std::remove(filename.c_str());
+  }
+  std::remove("zip_reader_test_old.zip");
+  std::remove("zip_reader_test_new.zip");
+}
+
+TEST(zip_reader, copy_raw_entries) {
+  const std::vector<std::string> filenames = {"zip_reader_test_copy_a.txt",
+                                              "zip_reader_test_copy_b.txt"};
+  std::vector<std::vector<sz::Byte>> contents(2);
+  for (int i = 0; i < 30000; ++i) {
+    contents[0].push_back(static_cast<sz::Byte>('a' + rand() % 4));
+    contents[1].push_back(static_cast<sz::Byte>('a' + i % 9));
+  }
+  sz::Zipper zipper;
+  for (size_t i = 0; i < filenames.size(); ++i) {
+    sz::io::write_bytes(filenames[i].c_str(), contents[i]);
+    zipper.add_entry(
+        sz::FileEntry(filenames[i], sz::CompressionMethod::deflate, 2));
+  }
+  zipper.update_buffer();
+  ASSERT_TRUE(zipper.write("zip_reader_test_copy.zip"));
+  for (const auto& filename : filenames) {
+    std::remove(filename.c_str());
+  }
+
+  // Copy the entries in reverse order.
+  {
+    sz::ZipReader src("zip_reader_test_copy.zip");
+    ASSERT_TRUE(src.is_open());
+    sz::ZipWriter writer("zip_reader_test_copied.zip");
+    for (size_t i = src.n_entries(); i-- > 0;) {
+      EXPECT_TRUE(writer.add_raw_entry(src, src.entry(i)));
+    }
+    ASSERT_TRUE(writer.close());
+  }
+
+  {
+    sz::ZipReader reader("zip_reader_test_copied.zip");
+    ASSERT_TRUE(reader.is_open());
+    ASSERT_EQ(reader.n_entries(), filenames.size());
+    for (size_t i = 0; i < filenames.size(); ++i) {
+      const auto& entry = reader.entry(filenames.size() - 1 - i);
+      EXPECT_EQ(reader.name(entry), filenames[i]);
+      std::vector<sz::Byte> dst(entry.uncompressed_size);
+      EXPECT_TRUE(reader.extract(entry, dst.data()));
+      EXPECT_EQ(dst, contents[i]);
+    }
+  }
+  std::remove("zip_reader_test_copy.zip");
+  std::remove("zip_reader_test_copied.zip");
+}
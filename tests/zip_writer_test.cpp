@@ -0,0 +1,158 @@
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "sz/common.hpp"
+#include "sz/zip_reader.hpp"
+#include "sz/zip_writer.hpp"
+
+#include "crc/crc32.hpp"
+#include "util/fs.hpp"
+#include "util/mapped_file.hpp"
+#include "wrapper/constants.hpp"
+#include "wrapper/zip_format.hpp"
+
+#include "gtest/gtest.h"
+
+namespace {
+
+sz::uint64 read_le(const std::vector<sz::Byte>& buffer, size_t pos, int n) {
+  sz::uint64 res = 0;
+  for (int i = n - 1; i >= 0; --i) {
+    res = res << 8 | buffer[pos + i];
+  }
+  return res;
+}
+
+}  // namespace
+
+TEST(zip_writer, data_descriptors) {
+  const std::vector<std::string> filenames = {
+      "zip_writer_test_text.txt", "zip_writer_test_random.bin",
+      "zip_writer_test_empty.txt", "zip_writer_test_small.txt",
+      "zip_writer_test_empty.bin"};
+  const std::vector<sz::CompressionMethod> methods = {
+      sz::CompressionMethod::deflate, sz::CompressionMethod::none,
+      sz::CompressionMethod::deflate, sz::CompressionMethod::deflate,
+      sz::CompressionMethod::none};
+  std::vector<std::vector<sz::Byte>> contents(filenames.size());
+  for (int i = 0; i < (5 << 19); ++i) {
+    contents[0].push_back(static_cast<sz::Byte>('a' + rand() % 6));
+  }
+  for (int i = 0; i < 100000; ++i) {
+    contents[1].push_back(static_cast<sz::Byte>(rand()));
+  }
+  for (int i = 0; i < 1000; ++i) {
+    contents[3].push_back(static_cast<sz::Byte>('a' + i % 7));
+  }
+
+  {
+    sz::ZipWriter writer("zip_writer_test.zip");
+    for (size_t i = 0; i < filenames.size(); ++i) {
+      sz::io::write_bytes(filenames[i].c_str(), contents[i]);
+      writer.add_file(filenames[i], methods[i], 2);
+    }
+    EXPECT_EQ(writer.n_entries(), filenames.size());
+    ASSERT_TRUE(writer.close());
+  }
+
+  const auto archive = sz::io::read_bytes("zip_writer_test.zip");
+  sz::ZipReader reader("zip_writer_test.zip");
+  ASSERT_TRUE(reader.is_open());
+  ASSERT_EQ(reader.n_entries(), filenames.size());
+  sz::uint64 next_header = 0;
+  for (size_t i = 0; i < filenames.size(); ++i) {
+    // The central directory lists the entries in the order they were added,
+    // one right after another.
+    const auto& entry = reader.entry(i);
+    EXPECT_EQ(reader.name(entry), filenames[i]);
+    EXPECT_EQ(entry.method, methods[i]);
+    EXPECT_EQ(entry.crc32,
+              sz::crc32::calculate(contents[i].data(), contents[i].size()));
+    EXPECT_EQ(entry.uncompressed_size, contents[i].size());
+    EXPECT_EQ(entry.off_local_file_header, next_header);
+
+    // Deflate entries are streamed, so their crc-32 and sizes follow the data
+    // in a data descriptor, and are zero in the local file header. Stored
+    // entries are read twice and have them in the local file header.
+    const size_t off = entry.off_local_file_header;
+    const bool streamed = methods[i] == sz::CompressionMethod::deflate;
+    EXPECT_EQ(read_le(archive, off, 4), sz::local_file_header_signature);
+    EXPECT_EQ(read_le(archive, off + 6, 2), entry.general_purpose);
+    EXPECT_EQ((entry.general_purpose & sz::GeneralPurposeDataDescriptor) != 0,
+              streamed);
+    EXPECT_EQ(read_le(archive, off + 14, 4), streamed ? 0 : entry.crc32);
+    EXPECT_EQ(read_le(archive, off + 18, 4),
+              streamed ? 0 : entry.compressed_size);
+    EXPECT_EQ(read_le(archive, off + 22, 4),
+              streamed ? 0 : entry.uncompressed_size);
+
+    const sz::Byte* data = reader.data(entry);
+    ASSERT_NE(data, nullptr);
+    next_header = static_cast<sz::uint64>(data - reader.file().data()) +
+                  entry.compressed_size;
+    if (streamed) {
+      EXPECT_EQ(read_le(archive, next_header, 4),
+                sz::data_descriptor_signature);
+      EXPECT_EQ(read_le(archive, next_header + 4, 4), entry.crc32);
+      EXPECT_EQ(read_le(archive, next_header + 8, 4), entry.compressed_size);
+      EXPECT_EQ(read_le(archive, next_header + 12, 4),
+                entry.uncompressed_size);
+      next_header += 16;
+    }
+
+    std::vector<sz::Byte> dst(entry.uncompressed_size);
+    EXPECT_TRUE(reader.extract(entry, dst.data()));
+    EXPECT_EQ(dst, contents[i]);
+  }
+  // The central directory follows the last entry.
+  EXPECT_EQ(read_le(archive, next_header, 4),
+            sz::central_directory_file_header_signature);
+
+  for (const auto& filename : filenames) {
+    std::remove(filename.c_str());
+  }
+  std::remove("zip_writer_test.zip");
+}
+
+TEST(zip_writer, kernel_copy) {
+  // Larger than ZipWriterKernelCopyMinSize, and not a whole number of pages,
+  // after an entry that leaves the target at an odd offset.
+  std::vector<sz::Byte> small(777);
+  std::vector<sz::Byte> large((3 << 20) + 12345);
+  for (auto* content : {&small, &large}) {
+    for (auto& byte : *content) {
+      byte = static_cast<sz::Byte>(rand());
+    }
+  }
+  sz::io::write_bytes("zip_writer_test_small.bin", small);
+  sz::io::write_bytes("zip_writer_test_large.bin", large);
+  {
+    sz::ZipWriter writer("zip_writer_test_copy.zip");
+    writer.add_file("zip_writer_test_small.bin", sz::CompressionMethod::deflate,
+                    2);
+    writer.add_file("zip_writer_test_large.bin", sz::CompressionMethod::none,
+                    2);
+    ASSERT_TRUE(writer.close());
+  }
+
+  sz::ZipReader reader("zip_writer_test_copy.zip");
+  ASSERT_TRUE(reader.is_open());
+  const auto* entry = reader.find("zip_writer_test_large.bin");
+  ASSERT_NE(entry, nullptr);
+  EXPECT_EQ(entry->method, sz::CompressionMethod::none);
+  EXPECT_EQ(entry->crc32, sz::crc32::calculate(large.data(), large.size()));
+  ASSERT_EQ(entry->compressed_size, large.size());
+  ASSERT_EQ(entry->uncompressed_size, large.size());
+  const sz::Byte* data = reader.data(*entry);
+  ASSERT_NE(data, nullptr);
+  EXPECT_TRUE(std::equal(large.begin(), large.end(), data));
+  std::vector<sz::Byte> dst(entry->uncompressed_size);
+  EXPECT_TRUE(reader.extract(*entry, dst.data()));
+  EXPECT_EQ(dst, large);
+
+  std::remove("zip_writer_test_small.bin");
+  std::remove("zip_writer_test_large.bin");
+  std::remove("zip_writer_test_copy.zip");
+}
@@ -0,0 +1,56 @@
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "sz/common.hpp"
+#include "sz/file_entry.hpp"
+#include "sz/zipper.hpp"
+
+#include "util/fs.hpp"
+
+#include "gtest/gtest.h"
+
+TEST(zipper, write_parallel) {
+  const std::vector<std::string> filenames = {
+      "zipper_test_text.txt", "zipper_test_random.bin",
+      "zipper_test_empty.bin", "zipper_test_stored.txt"};
+  std::vector<std::vector<sz::Byte>> contents(filenames.size());
+  for (int i = 0; i < 500000; ++i) {
+    contents[0].push_back(static_cast<sz::Byte>('a' + rand() % 6));
+  }
+  for (int i = 0; i < 200000; ++i) {
+    contents[1].push_back(static_cast<sz::Byte>(rand()));
+  }
+  for (int i = 0; i < 70000; ++i) {
+    contents[3].push_back(static_cast<sz::Byte>('a' + i % 11));
+  }
+
+  sz::Zipper zipper;
+  for (size_t i = 0; i < filenames.size(); ++i) {
+    sz::io::write_bytes(filenames[i].c_str(), contents[i]);
+    zipper.add_entry(sz::FileEntry(filenames[i],
+                                   i == 3 ? sz::CompressionMethod::none
+                                          : sz::CompressionMethod::deflate,
+                                   2));
+  }
+
+  // The entries are written at their offsets by the workers, and the result
+  // is the same as the archive built in memory.
+  ASSERT_TRUE(zipper.write_parallel("zipper_test_parallel.zip", 3));
+  zipper.update_buffer();
+  ASSERT_TRUE(zipper.write("zipper_test_serial.zip"));
+  const auto parallel = sz::io::read_bytes("zipper_test_parallel.zip");
+  const auto serial = sz::io::read_bytes("zipper_test_serial.zip");
+  EXPECT_FALSE(serial.empty());
+  EXPECT_EQ(parallel, serial);
+
+  // A target that cannot be created.
+  EXPECT_FALSE(
+      zipper.write_parallel("zipper_test_missing_dir/zipper_test.zip", 3));
+
+  for (const auto& filename : filenames) {
+    std::remove(filename.c_str());
+  }
+  std::remove("zipper_test_parallel.zip");
+  std::remove("zipper_test_serial.zip");
+}
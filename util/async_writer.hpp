@@ -0,0 +1,217 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#ifdef __linux__
+#include <cerrno>
+#include <sys/sendfile.h>
+#include <unistd.h>
+#endif
+
+#include "sz/types.hpp"
+
+#include "util/fs.hpp"
+
+namespace sz {
+
+namespace io {
+
+// A file writer whose disk writes are done by a background thread, so that
+// the caller can keep on computing while the previous bytes are written.
+// Small writes are gathered into chunks before being handed over.
+class AsyncFileWriter {
+ public:
+  AsyncFileWriter() = delete;
+
+  // max_pending: the maximum bytes waiting to be written. write() blocks when
+  // it is exceeded.
+  AsyncFileWriter(const char* filename, size_t max_pending)
+      : m_file(open_file(filename, "wb")),
+        m_max_pending(max_pending),
+        m_pending(0),
+        m_closing(false),
+        m_failed(m_file == nullptr),
+        m_offset(0) {
+    if (m_file) {
+      m_thread = std::thread(&AsyncFileWriter::run, this);
+    }
+  }
+
+  AsyncFileWriter(const AsyncFileWriter&) = delete;
+  AsyncFileWriter& operator=(const AsyncFileWriter&) = delete;
+  AsyncFileWriter(AsyncFileWriter&&) = delete;
+  AsyncFileWriter& operator=(AsyncFileWriter&&) = delete;
+
+  ~AsyncFileWriter() { close(); }
+
+  [[nodiscard]] bool is_open() const { return m_file != nullptr; }
+
+  // Number of bytes written so far, including the ones not on disk yet.
+  [[nodiscard]] uint64 offset() const { return m_offset; }
+
+  void write(const Byte* data, size_t n) {
+    m_offset += n;
+    while (n > 0) {
+      const size_t take = std::min(n, ChunkSize - m_chunk.size());
+      m_chunk.insert(m_chunk.end(), data, data + take);
+      data += take;
+      n -= take;
+      if (m_chunk.size() == ChunkSize) {
+        submit();
+      }
+    }
+  }
+
+  void write(const std::vector<Byte>& bytes) {
+    write(bytes.data(), bytes.size());
+  }
+
+  // Append up to n bytes at offset off of the file open as src_fd, copied by
+  // the kernel (copy_file_range, or sendfile where the file systems differ)
+  // without passing through user space.
+  // Return the number of bytes appended, which is less than n where the
+  // kernel cannot copy between the two files; the caller writes the rest.
+  uint64 copy_from(int src_fd, uint64 off, uint64 n) {
+    uint64 copied = 0;
+#ifdef __linux__
+    flush();
+    if (!m_file) {
+      return 0;
+    }
+    const int fd = fileno(m_file);
+    auto off_in = static_cast<off_t>(off);
+    bool use_sendfile = false;
+    while (copied < n) {
+      const size_t len = static_cast<size_t>(
+          std::min<uint64>(n - copied, MaxKernelCopySize));
+      const ssize_t k =
+          use_sendfile ? sendfile(fd, src_fd, &off_in, len)
+                       : copy_file_range(src_fd, &off_in, fd, nullptr, len, 0);
+      if (k < 0 && errno == EINTR) {
+        continue;
+      }
+      if (k < 0 && !use_sendfile &&
+          (errno == EXDEV || errno == ENOSYS || errno == EINVAL ||
+           errno == EOPNOTSUPP)) {
+        use_sendfile = true;
+        continue;
+      }
+      if (k <= 0) {
+        break;
+      }
+      copied += static_cast<uint64>(k);
+    }
+    // The descriptor has moved past the stdio position.
+    fseeko(m_file, 0, SEEK_END);
+    m_offset += copied;
+#else
+    (void)src_fd;
+    (void)off;
+    (void)n;
+#endif
+    return copied;
+  }
+
+  // Wait until all bytes are written to the file.
+  void flush() {
+    submit();
+    std::unique_lock lock(m_mtx);
+    m_cv_pop.wait(lock, [this] { return m_queue.empty() && !m_busy; });
+    if (m_file) {
+      fflush(m_file);
+    }
+  }
+
+  // Write the rest of the bytes and close the file.
+  // Return false if any write failed.
+  bool close() {
+    if (!m_file) {
+      return !m_failed;
+    }
+    submit();
+    {
+      std::unique_lock lock(m_mtx);
+      m_closing = true;
+    }
+    m_cv_push.notify_all();
+    m_thread.join();
+    if (fclose(m_file) != 0) {
+      m_failed = true;
+    }
+    m_file = nullptr;
+    return !m_failed;
+  }
+
+ private:
+  // Size of a chunk handed over to the background thread.
+  static constexpr size_t ChunkSize = 1 << 20;
+  // Bytes copied by the kernel per call, within what sendfile accepts.
+  static constexpr uint64 MaxKernelCopySize = 1 << 30;
+
+  FILE* m_file;
+  std::thread m_thread;
+  std::mutex m_mtx;
+  // Notified when a chunk is pushed or the writer is closing.
+  std::condition_variable m_cv_push;
+  // Notified when a chunk is written.
+  std::condition_variable m_cv_pop;
+  std::deque<std::vector<Byte>> m_queue;
+  std::vector<Byte> m_chunk;
+  size_t m_max_pending;
+  size_t m_pending;
+  bool m_busy = false;
+  bool m_closing;
+  bool m_failed;
+  uint64 m_offset;
+
+  // Hand over the current chunk to the background thread.
+  void submit() {
+    if (m_chunk.empty()) {
+      return;
+    }
+    {
+      std::unique_lock lock(m_mtx);
+      m_cv_pop.wait(lock, [this] {
+        return m_pending == 0 || m_pending + m_chunk.size() <= m_max_pending;
+      });
+      m_pending += m_chunk.size();
+      m_queue.push_back(std::move(m_chunk));
+    }
+    m_chunk = std::vector<Byte>();
+    m_chunk.reserve(ChunkSize);
+    m_cv_push.notify_one();
+  }
+
+  void run() {
+    std::unique_lock lock(m_mtx);
+    while (true) {
+      m_cv_push.wait(lock, [this] { return !m_queue.empty() || m_closing; });
+      if (m_queue.empty()) {
+        return;
+      }
+      std::vector<Byte> chunk = std::move(m_queue.front());
+      m_queue.pop_front();
+      m_busy = true;
+      lock.unlock();
+      if (fwrite(chunk.data(), sizeof(Byte), chunk.size(), m_file) !=
+          chunk.size()) {
+        m_failed = true;
+      }
+      lock.lock();
+      m_busy = false;
+      m_pending -= chunk.size();
+      m_cv_pop.notify_all();
+    }
+  }
+};
+
+}  // namespace io
+
+}  // namespace sz
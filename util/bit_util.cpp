@@ -1,5 +1,9 @@
 #include "util/bit_util.hpp"
 
+#include <cassert>
+#include <cstring>
+#include <utility>
+
 #ifdef SZ_USE_REVERSEBIT_TABLE
 #include "util/table_reversebits.hpp"
 #endif
@@ -112,6 +116,9 @@ void BitStream::append(const BitStream& rhs) {
 }
 
 void BitStream::align_to_byte(const int bit) {
+  if (m_cur_bit == 0) {
+    return;
+  }
   int t = 8 - m_cur_bit;
   while (t--) {
     write_bit(bit & 1);
@@ -178,4 +185,77 @@ void BitStream::expand() {
   m_buffer_end = &m_bytes[0] + m_cap;
 }
 
+BitStreamWriter::BitStreamWriter(ByteSink sink)
+    : m_sink(std::move(sink)),
+      m_staging(StagingSize),
+      m_staging_len(0),
+      m_carry(0),
+      m_carry_bits(0),
+      m_bits(0) {}
+
+void BitStreamWriter::write_bits(const uint64 payload, const int n) {
+  m_carry |= GetLowBits(payload, n) << m_carry_bits;
+  m_carry_bits += n;
+  m_bits += n;
+  while (m_carry_bits >= 8) {
+    put_byte(static_cast<Byte>(m_carry & BYTE_MASK));
+    m_carry >>= 8;
+    m_carry_bits -= 8;
+  }
+}
+
+void BitStreamWriter::append(const BitStream& bs) {
+  const size_t bits = bs.get_bits_size();
+  const size_t n = bits >> 3;
+  const Byte* p = bs.m_bytes.data();
+  if (m_carry_bits == 0) {
+    write_bytes(p, n);
+  } else {
+    // Each output byte consists of the carried bits and the low bits of the
+    // next input byte.
+    const int k = m_carry_bits;
+    for (const Byte* q = p + n; p < q; ++p) {
+      put_byte(static_cast<Byte>((m_carry | (*p << k)) & BYTE_MASK));
+      m_carry = *p >> (8 - k);
+    }
+    m_bits += n << 3;
+  }
+  if (bits & 7) {
+    write_bits(bs.m_bytes[n], static_cast<int>(bits & 7));
+  }
+}
+
+void BitStreamWriter::write_bytes(const Byte* data, const size_t n) {
+  assert(m_carry_bits == 0);
+  if (n == 0) {
+    return;
+  }
+  if (n < StagingSize - m_staging_len) {
+    memcpy(&m_staging[m_staging_len], data, sizeof(Byte) * n);
+    m_staging_len += n;
+  } else {
+    flush_staging();
+    m_sink(data, n);
+  }
+  m_bits += n << 3;
+}
+
+void BitStreamWriter::align_to_byte() {
+  if (m_carry_bits) {
+    write_bits(0, 8 - m_carry_bits);
+  }
+}
+
+void BitStreamWriter::flush() {
+  align_to_byte();
+  flush_staging();
+}
+
+void BitStreamWriter::flush_staging() {
+  if (m_staging_len) {
+    m_sink(m_staging.data(), m_staging_len);
+    m_staging_len = 0;
+  }
+}
+
 }  // namespace sz
@@ -4,6 +4,8 @@
 
 #include "sz/types.hpp"
 
+#include "util/byte_util.hpp"
+
 namespace sz {
 
 #ifdef SZ_USE_REVERSEBIT_TABLE
@@ -53,6 +55,8 @@ class BitStream {
   // If n is 0, export the whole bit flow; otherwise, export n bits.
   void export_bitstream(Byte* dst, size_t n = 0);
 
+  friend class BitStreamWriter;
+
  private:
   std::vector<Byte> m_bytes;
   size_t m_cap;
@@ -64,4 +68,57 @@ class BitStream {
   void expand();
 };
 
+// Writer of a bit flow that is passed to a byte sink as soon as bytes are
+// complete. Bit streams appended are shifted into a small staging buffer,
+// while byte aligned content goes to the sink without any copy.
+class BitStreamWriter {
+ public:
+  BitStreamWriter() = delete;
+  explicit BitStreamWriter(ByteSink sink);
+  BitStreamWriter(const BitStreamWriter&) = delete;
+  BitStreamWriter& operator=(const BitStreamWriter&) = delete;
+  BitStreamWriter(BitStreamWriter&&) = delete;
+  BitStreamWriter& operator=(BitStreamWriter&&) = delete;
+  ~BitStreamWriter() = default;
+
+  // Append the low n (<= 56) bits of payload. Little end is used.
+  void write_bits(uint64 payload, int n);
+
+  // Append a bit stream.
+  void append(const BitStream& bs);
+
+  // Append n bytes. The writer must be aligned to byte.
+  void write_bytes(const Byte* data, size_t n);
+
+  // Align to byte using bit 0.
+  void align_to_byte();
+
+  // Align to byte and pass all pending bytes to the sink.
+  void flush();
+
+  // Get the number of bits written.
+  [[nodiscard]] uint64 get_bits_size() const { return m_bits; }
+
+ private:
+  // Size of the staging buffer.
+  static constexpr size_t StagingSize = 64 << 10;
+
+  ByteSink m_sink;
+  std::vector<Byte> m_staging;
+  size_t m_staging_len;
+  // Bits that do not form a complete byte yet.
+  uint64 m_carry;
+  int m_carry_bits;
+  uint64 m_bits;
+
+  void put_byte(Byte x) {
+    m_staging[m_staging_len++] = x;
+    if (m_staging_len == StagingSize) {
+      flush_staging();
+    }
+  }
+
+  void flush_staging();
+};
+
 }  // namespace sz
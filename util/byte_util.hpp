@@ -21,6 +21,31 @@ inline void marshal_32(Byte*& p, uint32 x) {
   *p++ = static_cast<Byte>((x >> 24) & 0xFF);
 }
 
+inline void marshal_64(Byte*& p, uint64 x) {
+  marshal_32(p, static_cast<uint32>(x & 0xFFFFFFFF));
+  marshal_32(p, static_cast<uint32>(x >> 32));
+}
+
+inline uint16 unmarshal_16(const Byte*& p) {
+  const auto x = static_cast<uint16>(p[0] | p[1] << 8);
+  p += 2;
+  return x;
+}
+
+inline uint32 unmarshal_32(const Byte*& p) {
+  const uint32 x = static_cast<uint32>(p[0]) | static_cast<uint32>(p[1]) << 8 |
+                   static_cast<uint32>(p[2]) << 16 |
+                   static_cast<uint32>(p[3]) << 24;
+  p += 4;
+  return x;
+}
+
+inline uint64 unmarshal_64(const Byte*& p) {
+  const uint64 lo = unmarshal_32(p);
+  const uint64 hi = unmarshal_32(p);
+  return lo | hi << 32;
+}
+
 inline void marshal_string(Byte*& p, const char* src, size_t n) {
   memcpy(p, src, n);
   p += n;
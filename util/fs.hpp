@@ -1,5 +1,7 @@
 #pragma once
 
+#include <cstdio>
+#include <ctime>
 #include <fstream>
 #include <sys/stat.h>
 #include <vector>
@@ -7,14 +9,29 @@
 #include "sz/log.hpp"
 #include "sz/types.hpp"
 
+#include "util/byte_util.hpp"
+
 #ifdef WIN32
-#define STAT _stat
+#define STAT _stat64
+#else
+#define STAT stat
 #endif
 
 namespace sz {
 
 namespace io {
 
+// Open a file by C stream. Return nullptr on failure.
+inline FILE* open_file(const char* filename, const char* mode) {
+  FILE* file = nullptr;
+#ifdef WIN32
+  fopen_s(&file, filename, mode);
+#else
+  file = fopen(filename, mode);
+#endif
+  return file;
+}
+
 inline std::vector<Byte> read_bytes(const char* filename) {
   std::ifstream ifs;
   ifs.open(filename, std::ios::binary);
@@ -28,13 +45,13 @@ inline std::vector<Byte> read_bytes(const char* filename) {
 
 #ifdef SZ_IO_USE_FREAD_FWRITE
   ifs.close();
-  FILE* file = nullptr;
-  fopen_s(&file, filename, "rb");
+  FILE* file = open_file(filename, "rb");
   std::vector<Byte> res(size);
   if (!file) {
     log::panic("cannot open file '", filename, "'");
   } else {
-    fread(&res[0], sizeof(Byte), size, file);
+    fread(res.data(), sizeof(Byte), size, file);
+    fclose(file);
   }
   return res;
 #else
@@ -55,12 +72,12 @@ inline size_t write_bytes(const char* filename,
 
 #ifdef SZ_IO_USE_FREAD_FWRITE
   ofs.close();
-  FILE* file = nullptr;
-  fopen_s(&file, filename, "wb");
+  FILE* file = open_file(filename, "wb");
   if (!file) {
     log::panic("cannot write to file '", filename, "'");
   } else {
-    fwrite(&bytes[0], sizeof(Byte), bytes.size(), file);
+    fwrite(bytes.data(), sizeof(Byte), bytes.size(), file);
+    fclose(file);
   }
 #else
   std::vector<char> conv_bytes(bytes.begin(), bytes.end());
@@ -71,11 +88,57 @@ inline size_t write_bytes(const char* filename,
   return bytes.size();
 }
 
+// Read a file chunk by chunk from offset off, passing each chunk to sink.
+// Return the number of bytes read.
+inline uint64 read_chunks(const char* filename, uint64 off, size_t chunk_size,
+                          const ByteSink& sink) {
+  FILE* file = open_file(filename, "rb");
+  if (!file) {
+    log::panic("cannot open file '", filename, "'");
+  }
+#ifdef WIN32
+  const int seek = _fseeki64(file, static_cast<__int64>(off), SEEK_SET);
+#else
+  const int seek = fseeko(file, static_cast<off_t>(off), SEEK_SET);
+#endif
+  if (seek != 0) {
+    log::panic("cannot seek in file '", filename, "'");
+  }
+  std::vector<Byte> chunk(chunk_size);
+  uint64 total = 0;
+  for (size_t n; (n = fread(chunk.data(), sizeof(Byte), chunk_size, file));) {
+    sink(chunk.data(), n);
+    total += n;
+  }
+  fclose(file);
+  return total;
+}
+
+// Read a file chunk by chunk, passing each chunk to sink.
+// Return the size of the file.
+inline uint64 read_chunks(const char* filename, size_t chunk_size,
+                          const ByteSink& sink) {
+  return read_chunks(filename, 0, chunk_size, sink);
+}
+
+// Return the size of the file.
+inline uint64 get_file_size(const char* filename) {
+  struct STAT result {};
+  if (STAT(filename, &result) != 0) {
+    log::panic("cannot get size of ", filename);
+  }
+  return static_cast<uint64>(result.st_size);
+}
+
 inline Timestamp get_last_modify_time(const char* filename) {
   struct STAT result {};
   if (STAT(filename, &result) == 0) {
     struct tm tm {};
+#ifdef WIN32
     localtime_s(&tm, &result.st_mtime);
+#else
+    localtime_r(&result.st_mtime, &tm);
+#endif
     int year = tm.tm_year + 1900 - 1980;
     int month = tm.tm_mon + 1;
     int day = tm.tm_mday;
@@ -0,0 +1,116 @@
+#include "util/kernels.hpp"
+
+#include <cstring>
+
+#ifdef SZ_KERNELS_X86
+#include <immintrin.h>
+#endif
+
+namespace sz {
+
+namespace kernels {
+
+namespace {
+
+size_t match_length_generic(const Byte* a, const Byte* b, const size_t n) {
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    uint64 x;
+    uint64 y;
+    memcpy(&x, a + i, 8);
+    memcpy(&y, b + i, 8);
+    if (x != y) {
+      break;
+    }
+  }
+  while (i < n && a[i] == b[i]) {
+    ++i;
+  }
+  return i;
+}
+
+#ifdef SZ_KERNELS_X86
+
+__attribute__((target("sse2"))) size_t match_length_sse2(const Byte* a,
+                                                         const Byte* b,
+                                                         const size_t n) {
+  size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+    const __m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+    const auto eq =
+        static_cast<uint32>(_mm_movemask_epi8(_mm_cmpeq_epi8(x, y)));
+    if (eq != 0xFFFF) {
+      return i + __builtin_ctz(~eq);
+    }
+  }
+  return i + match_length_generic(a + i, b + i, n - i);
+}
+
+__attribute__((target("avx2"))) size_t match_length_avx2(const Byte* a,
+                                                         const Byte* b,
+                                                         const size_t n) {
+  size_t i = 0;
+  for (; i + 32 <= n; i += 32) {
+    const __m256i x =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+    const __m256i y =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+    const auto eq =
+        static_cast<uint32>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(x, y)));
+    if (eq != 0xFFFFFFFFu) {
+      return i + __builtin_ctz(~eq);
+    }
+  }
+  return i + match_length_sse2(a + i, b + i, n - i);
+}
+
+__attribute__((target("avx512f,avx512bw"))) size_t match_length_avx512(
+    const Byte* a, const Byte* b, const size_t n) {
+  for (size_t i = 0; i < n; i += 64) {
+    // The tail is loaded under a mask, which does not touch the bytes out of
+    // it.
+    const __mmask64 in = n - i >= 64 ? ~0ull : (1ull << (n - i)) - 1;
+    const __m512i x = _mm512_maskz_loadu_epi8(in, a + i);
+    const __m512i y = _mm512_maskz_loadu_epi8(in, b + i);
+    const __mmask64 ne = _mm512_mask_cmpneq_epi8_mask(in, x, y);
+    if (ne) {
+      return i + __builtin_ctzll(ne);
+    }
+  }
+  return n;
+}
+
+#endif
+
+constexpr Table Tables[] = {
+    {cpu::Isa::generic, match_length_generic},
+#ifdef SZ_KERNELS_X86
+    {cpu::Isa::sse2, match_length_sse2},
+    {cpu::Isa::avx2, match_length_avx2},
+    {cpu::Isa::avx512, match_length_avx512},
+#endif
+};
+
+}  // namespace
+
+const Table& table(const cpu::Isa isa) {
+  // An instruction set without kernels of its own uses those of the best one
+  // below it.
+  const Table* res = &Tables[0];
+  for (const Table& t : Tables) {
+    if (t.isa <= isa) {
+      res = &t;
+    }
+  }
+  return *res;
+}
+
+const Table& active() {
+  static const Table& res = table(cpu::active_isa());
+  return res;
+}
+
+}  // namespace kernels
+
+}  // namespace sz
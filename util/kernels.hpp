@@ -0,0 +1,34 @@
+#pragma once
+
+#include "sz/cpu.hpp"
+#include "sz/types.hpp"
+
+// Variants for x86 instruction sets are built with GCC and Clang, which can
+// compile each function for its own target.
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SZ_KERNELS_X86
+#endif
+
+namespace sz {
+
+namespace kernels {
+
+// Return the length of the common prefix of a and b, at most n.
+using MatchLengthFn = size_t (*)(const Byte* a, const Byte* b, size_t n);
+
+// The hot loops with a variant per instruction set. A caller in a loop takes
+// the function pointer out of the table once.
+struct Table {
+  cpu::Isa isa;
+  MatchLengthFn match_length;
+};
+
+// The kernels of isa, which must not be above cpu::detected_isa().
+[[nodiscard]] const Table& table(cpu::Isa isa);
+
+// The kernels of cpu::active_isa(), bound once on first use.
+[[nodiscard]] const Table& active();
+
+}  // namespace kernels
+
+}  // namespace sz
@@ -0,0 +1,118 @@
+#pragma once
+
+#ifdef WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "sz/types.hpp"
+
+namespace sz {
+
+namespace io {
+
+// A read-only memory map of a whole file.
+// Pages are loaded by the system on first access, so opening a large file
+// costs no reads by itself. On POSIX systems the descriptor is kept open, so
+// that parts of the file can also be copied by the kernel.
+class MappedFile {
+ public:
+  MappedFile() = delete;
+
+  explicit MappedFile(const char* filename) : m_data(nullptr), m_size(0) {
+#ifdef WIN32
+    m_file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, nullptr,
+                         OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    m_mapping = nullptr;
+    if (m_file == INVALID_HANDLE_VALUE) {
+      return;
+    }
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(m_file, &size)) {
+      return;
+    }
+    m_size = static_cast<uint64>(size.QuadPart);
+    m_open = true;
+    if (m_size == 0) {
+      return;
+    }
+    m_mapping =
+        CreateFileMappingA(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (m_mapping) {
+      m_data = static_cast<const Byte*>(
+          MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+    }
+    m_open = m_data != nullptr;
+#else
+    m_fd = ::open(filename, O_RDONLY);
+    if (m_fd < 0) {
+      return;
+    }
+    struct stat st {};
+    if (fstat(m_fd, &st) == 0) {
+      m_size = static_cast<uint64>(st.st_size);
+      m_open = true;
+      if (m_size != 0) {
+        void* p = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, m_fd, 0);
+        m_data = p == MAP_FAILED ? nullptr : static_cast<const Byte*>(p);
+        m_open = m_data != nullptr;
+      }
+    }
+#endif
+  }
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+  MappedFile(MappedFile&&) = delete;
+  MappedFile& operator=(MappedFile&&) = delete;
+
+  ~MappedFile() {
+#ifdef WIN32
+    if (m_data) {
+      UnmapViewOfFile(m_data);
+    }
+    if (m_mapping) {
+      CloseHandle(m_mapping);
+    }
+    if (m_file != INVALID_HANDLE_VALUE) {
+      CloseHandle(m_file);
+    }
+#else
+    if (m_data) {
+      munmap(const_cast<Byte*>(m_data), m_size);
+    }
+    if (m_fd >= 0) {
+      ::close(m_fd);
+    }
+#endif
+  }
+
+  [[nodiscard]] bool is_open() const { return m_open; }
+  [[nodiscard]] const Byte* data() const { return m_data; }
+  [[nodiscard]] uint64 size() const { return m_size; }
+#ifndef WIN32
+  [[nodiscard]] int fd() const { return m_fd; }
+#endif
+
+ private:
+  const Byte* m_data;
+  uint64 m_size;
+  bool m_open = false;
+#ifdef WIN32
+  HANDLE m_file;
+  HANDLE m_mapping;
+#else
+  int m_fd = -1;
+#endif
+};
+
+}  // namespace io
+
+}  // namespace sz
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <atomic>
+#include <cstdio>
+
+#ifdef WIN32
+#include <mutex>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "sz/types.hpp"
+
+#include "util/fs.hpp"
+
+namespace sz {
+
+namespace io {
+
+// A writer of a file whose size is known in advance. The file is allocated at
+// once, and bytes are written at given offsets, so that several threads can
+// write different parts of the file at the same time.
+// On POSIX systems the space is reserved by posix_fallocate and bytes are
+// written by pwrite. Elsewhere the writes are serialized by a lock.
+class PositionalFileWriter {
+ public:
+  PositionalFileWriter() = delete;
+
+  PositionalFileWriter(const char* filename, uint64 size) : m_failed(false) {
+#ifdef WIN32
+    m_file = open_file(filename, "wb");
+    m_failed = m_file == nullptr;
+    (void)size;
+#else
+    m_fd = ::open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (m_fd < 0) {
+      m_failed = true;
+      return;
+    }
+    if (size == 0) {
+      return;
+    }
+    // File systems without fallocate support still get the final size, so
+    // that the file is not extended piece by piece.
+    int err = posix_fallocate(m_fd, 0, static_cast<off_t>(size));
+    if (err == EINVAL || err == EOPNOTSUPP) {
+      err = ftruncate(m_fd, static_cast<off_t>(size)) == 0 ? 0 : errno;
+    }
+    m_failed = err != 0;
+#endif
+  }
+
+  PositionalFileWriter(const PositionalFileWriter&) = delete;
+  PositionalFileWriter& operator=(const PositionalFileWriter&) = delete;
+  PositionalFileWriter(PositionalFileWriter&&) = delete;
+  PositionalFileWriter& operator=(PositionalFileWriter&&) = delete;
+
+  ~PositionalFileWriter() { close(); }
+
+  [[nodiscard]] bool is_open() const {
+#ifdef WIN32
+    return m_file != nullptr && !m_failed;
+#else
+    return m_fd >= 0 && !m_failed;
+#endif
+  }
+
+  // Write n bytes at offset off of the file. Safe to call from several
+  // threads at the same time. Return false if the write failed.
+  bool write_at(uint64 off, const Byte* data, size_t n) {
+#ifdef WIN32
+    std::lock_guard lock(m_mtx);
+    if (_fseeki64(m_file, static_cast<long long>(off), SEEK_SET) != 0 ||
+        fwrite(data, sizeof(Byte), n, m_file) != n) {
+      m_failed = true;
+      return false;
+    }
+#else
+    while (n > 0) {
+      const ssize_t written =
+          pwrite(m_fd, data, n, static_cast<off_t>(off));
+      if (written < 0 && errno == EINTR) {
+        continue;
+      }
+      if (written <= 0) {
+        m_failed = true;
+        return false;
+      }
+      data += written;
+      n -= static_cast<size_t>(written);
+      off += static_cast<uint64>(written);
+    }
+#endif
+    return true;
+  }
+
+  // Close the file. Return false if any write failed.
+  bool close() {
+#ifdef WIN32
+    if (m_file && fclose(m_file) != 0) {
+      m_failed = true;
+    }
+    m_file = nullptr;
+#else
+    if (m_fd >= 0 && ::close(m_fd) != 0) {
+      m_failed = true;
+    }
+    m_fd = -1;
+#endif
+    return !m_failed;
+  }
+
+ private:
+#ifdef WIN32
+  FILE* m_file;
+  std::mutex m_mtx;
+#else
+  int m_fd;
+#endif
+  std::atomic<bool> m_failed;
+};
+
+}  // namespace io
+
+}  // namespace sz
@@ -1,12 +1,25 @@
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <iostream>
 #include <mutex>
 #include <string>
+#include <thread>
 #include <utility>
 
 namespace sz {
 
+// Time between two redraws of a displayed progress bar.
+constexpr std::chrono::milliseconds ProgressBarRenderInterval(100);
+
+// A progress bar shared by the workers. The workers only add to an atomic
+// counter, and a render thread, running while the bar is displayed, redraws
+// it at most once per ProgressBarRenderInterval. Progress is only counted
+// while the bar is displayed, so a bar never displayed costs a relaxed load
+// per update.
 class ProgressBar {
  public:
   ProgressBar() = delete;
@@ -21,48 +34,55 @@ class ProgressBar {
         m_ch_space(ch_space),
         m_ch_fill(ch_fill),
         m_ch_bound(ch_bound),
-        m_percentage(0.0f),
-        m_fill_cnt(0),
+        m_fill_cnt(-1),
         m_display_flag(false) {}
+  ProgressBar(const ProgressBar&) = delete;
+  ProgressBar& operator=(const ProgressBar&) = delete;
+  ProgressBar(ProgressBar&&) = delete;
+  ProgressBar& operator=(ProgressBar&&) = delete;
+  ~ProgressBar() { set_display(false); }
 
   void set_display(const bool flag) {
-    std::unique_lock lock(m_mtx);
-    if (flag != m_display_flag) {
-      m_display_flag = flag;
-      if (m_display_flag) {
-        flush_display();
-      } else {
-        *m_os << "\n\r";
-        m_os->flush();
+    if (flag == m_display_flag.load(std::memory_order_relaxed)) {
+      return;
+    }
+    if (flag) {
+      m_display_flag = true;
+      {
+        std::lock_guard lock(m_mtx);
+        flush_display(true);
       }
+      m_renderer = std::thread(&ProgressBar::render_loop, this);
+    } else {
+      {
+        std::lock_guard lock(m_mtx);
+        m_display_flag = false;
+      }
+      m_cv.notify_one();
+      m_renderer.join();
+      flush_display(true);
+      *m_os << "\n\r";
+      m_os->flush();
     }
   }
 
   void increase_progress(const size_t delta) {
-    std::unique_lock lock(m_mtx);
-    m_accumulate += delta;
-    uniform_accumulation();
-    update_percentage();
+    if (m_display_flag.load(std::memory_order_relaxed)) {
+      m_accumulate.fetch_add(delta, std::memory_order_relaxed);
+    }
   }
 
   void set_progress(const size_t progress) {
-    std::unique_lock lock(m_mtx);
-    m_accumulate = progress;
-    uniform_accumulation();
-    update_percentage();
+    m_accumulate.store(progress, std::memory_order_relaxed);
   }
 
-  void set_full() {
-    std::unique_lock lock(m_mtx);
-    m_accumulate = m_workload;
-    update_percentage();
-  }
+  void set_full() { m_accumulate.store(m_workload, std::memory_order_relaxed); }
 
  private:
   std::string m_display_name;
   std::ostream* m_os;
 
-  size_t m_accumulate;
+  std::atomic<size_t> m_accumulate;
   size_t m_workload;
 
   int m_width;
@@ -70,43 +90,45 @@ class ProgressBar {
   char m_ch_fill;
   char m_ch_bound;
 
-  float m_percentage;
+  // Only touched by the thread drawing the bar.
   int m_fill_cnt;
-  bool m_display_flag;
 
+  std::atomic<bool> m_display_flag;
+  std::thread m_renderer;
   std::mutex m_mtx;
+  std::condition_variable m_cv;
 
-  void uniform_accumulation() {
-    if (m_accumulate > m_workload) {
-      m_accumulate = m_workload;
+  void render_loop() {
+    std::unique_lock lock(m_mtx);
+    while (!m_cv.wait_for(lock, ProgressBarRenderInterval,
+                          [this] { return !m_display_flag; })) {
+      flush_display(false);
     }
   }
 
-  void update_percentage() {
-    m_percentage =
-        static_cast<float>(m_accumulate) / static_cast<float>(m_workload);
+  // Draw the bar if it has changed since last drawn, or if forced.
+  void flush_display(const bool force) {
+    const size_t accumulate =
+        std::min(m_accumulate.load(std::memory_order_relaxed), m_workload);
+    const float percentage = m_workload ? static_cast<float>(accumulate) /
+                                              static_cast<float>(m_workload)
+                                        : 1.0f;
     const int fill_cnt =
-        static_cast<int>(m_percentage * static_cast<float>(m_width));
-    if (fill_cnt == m_fill_cnt && m_percentage < 1.0f) {
+        static_cast<int>(percentage * static_cast<float>(m_width));
+    if (fill_cnt == m_fill_cnt && !force) {
       return;
     }
     m_fill_cnt = fill_cnt;
-    flush_display();
-  }
 
-  void flush_display() const {
-    if (!m_display_flag) {
-      return;
-    }
     *m_os << m_display_name << " [";
-    for (int i = 0; i < m_fill_cnt - 1; ++i) {
+    for (int i = 0; i < fill_cnt - 1; ++i) {
       *m_os << m_ch_fill;
     }
-    *m_os << ((m_percentage == 1.0f) ? m_ch_fill : m_ch_bound);
-    for (int i = m_fill_cnt; i < m_width; ++i) {
+    *m_os << ((percentage == 1.0f) ? m_ch_fill : m_ch_bound);
+    for (int i = fill_cnt; i < m_width; ++i) {
       *m_os << m_ch_space;
     }
-    *m_os << "] " << static_cast<int>(m_percentage * 100.0f) << " %    \r";
+    *m_os << "] " << static_cast<int>(percentage * 100.0f) << " %    \r";
     m_os->flush();
   }
 };
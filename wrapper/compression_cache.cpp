@@ -0,0 +1,265 @@
+#include "sz/compression_cache.hpp"
+
+#include <cinttypes>
+#include <cstdio>
+#include <filesystem>
+#include <random>
+
+#include "sz/common.hpp"
+#include "sz/log.hpp"
+#include "sz/memory.hpp"
+
+#include "crc/xxhash64.hpp"
+#include "util/byte_util.hpp"
+#include "util/fs.hpp"
+#include "util/mapped_file.hpp"
+
+namespace sz {
+
+namespace {
+
+// Signature of a cache file.
+constexpr uint32 CacheFileSignature = 0x32435A53;  // "SZC2"
+// Signature, method, crc-32, uncompressed size, data and extra field length,
+// and checksum.
+constexpr size_t CacheFileHeaderLength = 4 + 2 + 4 + 8 + 8 + 4 + 8;
+
+// File name of the key in the cache directory.
+std::string key_name(const CompressionCache::Key& key) {
+  char buf[96];
+  snprintf(buf, sizeof(buf), "%016" PRIx64 "-%" PRIu64 "-m%u-l%d%c-s%zu",
+           key.hash, key.size, static_cast<unsigned>(key.method), key.level,
+           key.static_coding ? 's' : 'd', key.section_size);
+  return buf;
+}
+
+// Share the payload, charging its bytes until the last user releases it.
+std::shared_ptr<const CompressionCache::Payload> make_payload(
+    CompressionCache::Payload payload) {
+  const uint64 bytes = payload.data.size() + payload.extra.size();
+  memory::charge(memory::Use::payload, bytes);
+  return std::shared_ptr<const CompressionCache::Payload>(
+      new CompressionCache::Payload(std::move(payload)),
+      [bytes](const CompressionCache::Payload* p) {
+        memory::release(memory::Use::payload, bytes);
+        delete p;
+      });
+}
+
+// XXH64 of the data and the extra field of a payload, which catches cache
+// files damaged on disk. The crc-32 only covers the uncompressed content.
+uint64 payload_checksum(const Byte* data, const size_t data_length,
+                        const Byte* extra, const size_t extra_length) {
+  return xxhash64::calculate(data, data_length,
+                             xxhash64::calculate(extra, extra_length));
+}
+
+}  // namespace
+
+CompressionCache::CompressionCache(const char* dir) : m_dir(dir) {
+  std::error_code ec;
+  std::filesystem::create_directories(m_dir, ec);
+  if (ec) {
+    log::panic("cannot create cache directory '", m_dir, "'");
+  }
+}
+
+CompressionCache::Key CompressionCache::make_key(
+    const Byte* data, const size_t n, const CompressionMethod method,
+    const CompressionOptions& options) {
+  const bool deflate = method == CompressionMethod::deflate;
+  return Key{xxhash64::calculate(data, n),
+             n,
+             method,
+             deflate ? options.lz77_level : 0,
+             deflate && options.use_static,
+             deflate && options.sync_sections ? options.section_size : 0};
+}
+
+std::shared_ptr<const CompressionCache::Payload> CompressionCache::find(
+    const Key& key) {
+  const std::string name = key_name(key);
+  {
+    std::lock_guard lock(m_mutex);
+    auto it = m_payloads.find(name);
+    if (it != m_payloads.end()) {
+      if (auto payload = it->second.lock()) {
+        ++m_n_hits;
+        return payload;
+      }
+    }
+  }
+  if (m_dir.empty()) {
+    return nullptr;
+  }
+  auto payload = load(name, key);
+  if (payload) {
+    std::lock_guard lock(m_mutex);
+    m_payloads[name] = payload;
+    ++m_n_hits;
+  }
+  return payload;
+}
+
+std::shared_ptr<const CompressionCache::Payload> CompressionCache::insert(
+    const Key& key, Payload payload) {
+  const std::string name = key_name(key);
+  auto shared = make_payload(std::move(payload));
+  {
+    std::lock_guard lock(m_mutex);
+    m_payloads[name] = shared;
+  }
+  if (!m_dir.empty()) {
+    store(name, key, *shared);
+  }
+  return shared;
+}
+
+size_t CompressionCache::n_hits() const {
+  std::lock_guard lock(m_mutex);
+  return m_n_hits;
+}
+
+std::shared_ptr<const CompressionCache::Payload> CompressionCache::load(
+    const std::string& name, const Key& key) const {
+  const std::string path = m_dir + "/" + name;
+  FILE* file = io::open_file(path.c_str(), "rb");
+  if (!file) {
+    return nullptr;
+  }
+  std::vector<Byte> bytes;
+  Byte chunk[1 << 16];
+  for (size_t n; (n = fread(chunk, 1, sizeof(chunk), file));) {
+    bytes.insert(bytes.end(), chunk, chunk + n);
+  }
+  fclose(file);
+
+  // A file that does not match its name is ignored, and written again.
+  if (bytes.size() < CacheFileHeaderLength) {
+    return nullptr;
+  }
+  const Byte* p = bytes.data();
+  Payload payload;
+  if (unmarshal_32(p) != CacheFileSignature) {
+    return nullptr;
+  }
+  payload.method = static_cast<CompressionMethod>(unmarshal_16(p));
+  payload.crc32 = unmarshal_32(p);
+  const uint64 uncompressed_size = unmarshal_64(p);
+  const uint64 data_length = unmarshal_64(p);
+  const uint32 extra_length = unmarshal_32(p);
+  const uint64 checksum = unmarshal_64(p);
+  // The lengths are compared one at a time so that their sum cannot wrap.
+  const uint64 payload_length = bytes.size() - CacheFileHeaderLength;
+  if (uncompressed_size != key.size || data_length > payload_length ||
+      extra_length != payload_length - data_length ||
+      payload_checksum(p, data_length, p + data_length, extra_length) !=
+          checksum) {
+    log::log("Ignore corrupted cache file '", path, "'");
+    return nullptr;
+  }
+  payload.data.assign(p, p + data_length);
+  payload.extra.assign(p + data_length, p + data_length + extra_length);
+  return make_payload(std::move(payload));
+}
+
+void CompressionCache::store(const std::string& name, const Key& key,
+                             const Payload& payload) const {
+  FileWriter writer(m_dir + "/" + name, key.size);
+  writer.write(payload.data.data(), payload.data.size());
+  (void)writer.finish(payload.method, payload.crc32, payload.extra);
+}
+
+std::unique_ptr<CompressionCache::FileWriter> CompressionCache::store_stream(
+    const Key& key) const {
+  if (m_dir.empty()) {
+    return nullptr;
+  }
+  return std::make_unique<FileWriter>(m_dir + "/" + key_name(key), key.size);
+}
+
+CompressionCache::FileWriter::FileWriter(std::string path,
+                                         const uint64 uncompressed_size)
+    : m_path(std::move(path)),
+      // Written under a unique name and renamed, so that other processes
+      // sharing the directory never see a partial file.
+      m_tmp_path(m_path + ".tmp" + std::to_string(std::random_device{}())),
+      m_uncompressed_size(uncompressed_size),
+      m_file(io::open_file(m_tmp_path.c_str(), "wb")),
+      m_ok(m_file != nullptr) {
+  if (!m_file) {
+    log::log("Cannot write cache file '", m_tmp_path, "'");
+    return;
+  }
+  // The header is written once the lengths and the checksum are known.
+  const std::vector<Byte> header(CacheFileHeaderLength);
+  m_ok = fwrite(header.data(), 1, header.size(), m_file) == header.size();
+}
+
+CompressionCache::FileWriter::~FileWriter() {
+  if (m_file) {
+    fclose(m_file);
+    std::error_code ec;
+    std::filesystem::remove(m_tmp_path, ec);
+  }
+}
+
+void CompressionCache::FileWriter::write(const Byte* data, const size_t n) {
+  // fwrite() must not be passed the null data of an empty vector.
+  if (m_ok && n > 0) {
+    m_ok = fwrite(data, 1, n, m_file) == n;
+  }
+  m_data_length += n;
+}
+
+bool CompressionCache::FileWriter::finish(const CompressionMethod method,
+                                          const CRC32Value crc32,
+                                          const std::vector<Byte>& extra) {
+  if (!m_file) {
+    return false;
+  }
+  if (m_ok && !extra.empty()) {
+    m_ok = fwrite(extra.data(), 1, extra.size(), m_file) == extra.size();
+  }
+  m_ok = m_ok && fflush(m_file) == 0;
+
+  // The data has left memory already, so the checksum is taken on the file.
+  uint64 checksum = 0;
+  if (m_ok) {
+    const io::MappedFile file(m_tmp_path.c_str());
+    m_ok = file.is_open() && file.size() == CacheFileHeaderLength +
+                                                m_data_length + extra.size();
+    if (m_ok) {
+      const Byte* payload = file.data() + CacheFileHeaderLength;
+      checksum = payload_checksum(payload, m_data_length,
+                                  payload + m_data_length, extra.size());
+    }
+  }
+
+  std::vector<Byte> header(CacheFileHeaderLength);
+  Byte* p = header.data();
+  marshal_32(p, CacheFileSignature);
+  marshal_16(p, static_cast<uint16>(method));
+  marshal_32(p, crc32);
+  marshal_64(p, m_uncompressed_size);
+  marshal_64(p, m_data_length);
+  marshal_32(p, static_cast<uint32>(extra.size()));
+  marshal_64(p, checksum);
+  m_ok = m_ok && fseek(m_file, 0, SEEK_SET) == 0 &&
+         fwrite(header.data(), 1, header.size(), m_file) == header.size();
+  m_ok = fclose(m_file) == 0 && m_ok;
+  m_file = nullptr;
+
+  std::error_code ec;
+  if (m_ok) {
+    std::filesystem::rename(m_tmp_path, m_path, ec);
+  }
+  if (!m_ok || ec) {
+    log::log("Cannot write cache file '", m_path, "'");
+    std::filesystem::remove(m_tmp_path, ec);
+    return false;
+  }
+  return true;
+}
+
+}  // namespace sz
@@ -7,5 +7,8 @@ namespace sz {
 constexpr uint32 local_file_header_signature = 0x04034B50;
 constexpr uint32 central_directory_file_header_signature = 0x02014b50;
 constexpr uint32 endof_central_directory_file_header_signature = 0x06054b50;
+constexpr uint32 data_descriptor_signature = 0x08074b50;
+constexpr uint32 zip64_endof_central_directory_signature = 0x06064b50;
+constexpr uint32 zip64_endof_central_directory_locator_signature = 0x07064b50;
 
 }  // namespace sz
@@ -0,0 +1,244 @@
+#include "sz/cpu.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef WIN32
+#include <sched.h>
+#endif
+
+#include "sz/log.hpp"
+
+#include "util/kernels.hpp"
+
+#ifdef SZ_KERNELS_X86
+#include <cpuid.h>
+#endif
+
+namespace sz {
+
+namespace cpu {
+
+namespace {
+
+// Return the first line of the file, or "" if it cannot be read.
+std::string read_line(const std::string& path) {
+  std::ifstream ifs(path);
+  std::string line;
+  std::getline(ifs, line);
+  return line;
+}
+
+// CPUs granted by a quota of quota us per period us, rounded up, or 0 if
+// there is no quota.
+size_t quota_cpus(const long long quota, const long long period) {
+  if (quota <= 0 || period <= 0) {
+    return 0;
+  }
+  return static_cast<size_t>((quota + period - 1) / period);
+}
+
+// cgroup v2: cpu.max holds "$MAX $PERIOD", where $MAX may be "max".
+size_t v2_cpus(const std::string& dir) {
+  std::istringstream iss(read_line(dir + "/cpu.max"));
+  std::string quota;
+  long long period = 0;
+  if (!(iss >> quota >> period) || quota == "max") {
+    return 0;
+  }
+  return quota_cpus(std::strtoll(quota.c_str(), nullptr, 10), period);
+}
+
+// cgroup v1: the quota is -1 if there is none.
+size_t v1_cpus(const std::string& dir) {
+  return quota_cpus(
+      std::strtoll(read_line(dir + "/cpu.cfs_quota_us").c_str(), nullptr, 10),
+      std::strtoll(read_line(dir + "/cpu.cfs_period_us").c_str(), nullptr,
+                   10));
+}
+
+#ifndef WIN32
+// The CPUs of the affinity mask of the process.
+std::vector<int> affinity_cpus() {
+  std::vector<int> cpus;
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+    for (int i = 0; i < CPU_SETSIZE; ++i) {
+      if (CPU_ISSET(i, &set)) {
+        cpus.push_back(i);
+      }
+    }
+  }
+  return cpus;
+}
+#endif
+
+#ifdef SZ_KERNELS_X86
+// The state components enabled by the OS (XCR0).
+unsigned long long xgetbv0() {
+  unsigned int lo = 0;
+  unsigned int hi = 0;
+  __asm__ volatile("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+  return static_cast<unsigned long long>(hi) << 32 | lo;
+}
+#endif
+
+Isa probe_isa() {
+#ifdef SZ_KERNELS_X86
+  unsigned int a = 0;
+  unsigned int b = 0;
+  unsigned int c = 0;
+  unsigned int d = 0;
+  if (!__get_cpuid(1, &a, &b, &c, &d) || !(d & bit_SSE2)) {
+    return Isa::generic;
+  }
+  // AVX registers are only usable if the OS saves them: the YMM state (bits 1
+  // and 2 of XCR0), and for AVX-512 the opmask and ZMM states (bits 5 to 7).
+  if (!(c & bit_OSXSAVE)) {
+    return Isa::sse2;
+  }
+  const unsigned long long xcr0 = xgetbv0();
+  if ((xcr0 & 0x06) != 0x06 || !__get_cpuid_count(7, 0, &a, &b, &c, &d) ||
+      !(b & bit_AVX2)) {
+    return Isa::sse2;
+  }
+  if ((xcr0 & 0xE0) != 0xE0 || !(b & bit_AVX512F) || !(b & bit_AVX512BW)) {
+    return Isa::avx2;
+  }
+  return Isa::avx512;
+#else
+  return Isa::generic;
+#endif
+}
+
+}  // namespace
+
+size_t cgroup_cpus(const std::string& proc_cgroup, const std::string& root) {
+  size_t res = 0;
+  const auto take = [&res](const size_t n) {
+    if (n && (!res || n < res)) {
+      res = n;
+    }
+  };
+  std::istringstream iss(proc_cgroup);
+  // Each line is "hierarchy-ID:controller-list:cgroup-path".
+  for (std::string line; std::getline(iss, line);) {
+    const size_t a = line.find(':');
+    const size_t b = a == std::string::npos ? a : line.find(':', a + 1);
+    if (b == std::string::npos) {
+      continue;
+    }
+    const std::string controllers = "," + line.substr(a + 1, b - a - 1) + ",";
+    std::string path = line.substr(b + 1);
+    if (path == "/") {
+      path.clear();
+    }
+    if (controllers == ",,") {
+      // cgroup v2, where the quota of every ancestor applies.
+      for (;;) {
+        take(v2_cpus(root + path));
+        const size_t slash = path.rfind('/');
+        if (slash == std::string::npos) {
+          break;
+        }
+        path.erase(slash);
+      }
+    } else if (controllers.find(",cpu,") != std::string::npos) {
+      // cgroup v1. Inside a container, the cgroup of the process is usually
+      // mounted as the root of the hierarchy.
+      for (const char* mount : {"/cpu", "/cpu,cpuacct"}) {
+        take(v1_cpus(root + mount + path));
+        take(v1_cpus(root + mount));
+      }
+    }
+  }
+  return res;
+}
+
+size_t available_cpus() {
+  size_t res = std::thread::hardware_concurrency();
+#ifndef WIN32
+  if (const size_t n = affinity_cpus().size(); n) {
+    res = n;
+  }
+  std::ostringstream proc_cgroup;
+  proc_cgroup << std::ifstream("/proc/self/cgroup").rdbuf();
+  if (const size_t n = cgroup_cpus(proc_cgroup.str(), "/sys/fs/cgroup");
+      n && (!res || n < res)) {
+    res = n;
+  }
+#endif
+  return std::max<size_t>(res, 1);
+}
+
+bool pin_thread(const size_t worker) {
+#ifdef WIN32
+  (void)worker;
+  return false;
+#else
+  // Taken once, before any worker is pinned.
+  static const std::vector<int> cpus = affinity_cpus();
+  if (cpus.empty()) {
+    return false;
+  }
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpus[worker % cpus.size()], &set);
+  return sched_setaffinity(0, sizeof(set), &set) == 0;
+#endif
+}
+
+const char* isa_name(const Isa isa) {
+  switch (isa) {
+    case Isa::generic:
+      return "generic";
+    case Isa::sse2:
+      return "sse2";
+    case Isa::avx2:
+      return "avx2";
+    case Isa::avx512:
+      return "avx512";
+  }
+  return "";
+}
+
+bool parse_isa(const std::string& name, Isa& isa) {
+  for (const Isa i : {Isa::generic, Isa::sse2, Isa::avx2, Isa::avx512}) {
+    if (name == isa_name(i)) {
+      isa = i;
+      return true;
+    }
+  }
+  return false;
+}
+
+Isa detected_isa() {
+  static const Isa isa = probe_isa();
+  return isa;
+}
+
+Isa active_isa() {
+  static const Isa isa = [] {
+    Isa res = detected_isa();
+    if (const char* forced = std::getenv("SZ_FORCE_ISA"); forced) {
+      Isa forced_isa = res;
+      if (!parse_isa(forced, forced_isa)) {
+        log::panic("Unrecognized SZ_FORCE_ISA: ", forced);
+      }
+      // An instruction set the CPU lacks cannot be forced.
+      res = std::min(res, forced_isa);
+    }
+    return res;
+  }();
+  return isa;
+}
+
+}  // namespace cpu
+
+}  // namespace sz
@@ -1,23 +1,34 @@
 #include "sz/file_entry.hpp"
 
 #include <cassert>
+#include <chrono>
 
 #include "sz/common.hpp"
+#include "sz/trace.hpp"
 
 #include "compress/compressor.hpp"
 #include "compress/cps_deflate.hpp"
 #include "compress/cps_store.hpp"
 #include "crc/crc32.hpp"
-#include "util/byte_util.hpp"
 #include "util/fs.hpp"
-#include "wrapper/constants.hpp"
 #include "wrapper/version.hpp"
+#include "wrapper/zip_format.hpp"
 
 namespace sz {
 
 FileEntry::FileEntry(const char* filename, CompressionMethod method,
                      size_t thread_cnt)
+    : FileEntry(filename, method, thread_cnt, CompressionOptions(), nullptr) {}
+
+FileEntry::FileEntry(const char* filename, CompressionMethod method,
+                     size_t thread_cnt, const CompressionOptions& options)
+    : FileEntry(filename, method, thread_cnt, options, nullptr) {}
+
+FileEntry::FileEntry(const char* filename, CompressionMethod method,
+                     size_t thread_cnt, const CompressionOptions& options,
+                     std::shared_ptr<CompressionCache> cache)
     : m_raw(io::read_bytes(filename)),
+      m_raw_charge(memory::Use::source, m_raw.size()),
       m_ver_made{Version},
       m_ver_extract{ExtractVersion},
       m_general_purpose{0},
@@ -27,99 +38,156 @@ FileEntry::FileEntry(const char* filename, CompressionMethod method,
       m_disk_number{0},
       m_internal_attr{0},
       m_external_attr{0},
-      m_filename{filename} {
-  m_crc32 = crc32::calculate(&m_raw[0], m_raw.size());
+      m_filename{filename},
+      m_cache{std::move(cache)},
+      m_cache_key{},
+      m_seconds(0),
+      m_cached(false) {
+  const auto start = std::chrono::steady_clock::now();
+  m_crc32 = crc32::calculate(m_raw.data(), m_raw.size());
+  if (m_cache) {
+    m_cache_key = CompressionCache::make_key(m_raw.data(), m_raw.size(),
+                                             m_method, options);
+    m_payload = m_cache->find(m_cache_key);
+    if (m_payload && m_payload->crc32 == m_crc32) {
+      log::log("Reuse the compressed content of '", filename, "'");
+      m_method = m_payload->method;
+      m_cached = true;
+      m_seconds = std::chrono::duration<double>(
+                      std::chrono::steady_clock::now() - start)
+                      .count();
+      return;
+    }
+    m_payload = nullptr;
+  }
   switch (m_method) {
     case CompressionMethod::none:
       m_compressor = std::make_shared<StoreCompressor>();
       break;
     case CompressionMethod::deflate:
-      m_compressor = std::make_shared<DeflateCompressor>(
-          deflate_use_static ? DeflateCodingType::static_coding
-                             : DeflateCodingType::dynamic_coding,
-          thread_cnt);
+      m_compressor = std::make_shared<DeflateCompressor>(options, thread_cnt);
       break;
   }
-  m_compressor->feed(&m_raw[0], m_raw.size());
+  m_compressor->feed(m_raw.data(), m_raw.size());
   m_compressor->compress();
+  m_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                            start)
+                  .count();
 }
 
 void FileEntry::compress() {
+  if (m_payload) {
+    return;
+  }
+  trace::Span span("file_entry::compress");
+  const auto start = std::chrono::steady_clock::now();
   m_compressor->compress();
   if (m_method != CompressionMethod::none &&
       m_compressor->get_length_compressed() > m_raw.size()) {
     log::log("Use store instead.");
     m_method = CompressionMethod::none;
     m_compressor = std::make_shared<StoreCompressor>();
-    m_compressor->feed(&m_raw[0], m_raw.size());
+    m_compressor->feed(m_raw.data(), m_raw.size());
     m_compressor->compress();
   }
+  const auto deflate =
+      std::dynamic_pointer_cast<DeflateCompressor>(m_compressor);
+  m_block_stats = deflate ? deflate->get_block_stats()
+                          : std::vector<BlockStats>();
+  m_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                             start)
+                   .count();
+
+  if (m_cache) {
+    // The compressed content moves to the cache, to be shared with the
+    // entries of the same content.
+    CompressionCache::Payload payload{
+        m_method, m_crc32,
+        std::vector<Byte>(m_compressor->get_length_compressed()), {}};
+    m_compressor->write_result(payload.data.data());
+    payload.extra = make_record(0).extra;
+    m_payload = m_cache->insert(m_cache_key, std::move(payload));
+    m_compressor = nullptr;
+  }
 }
 
 SizeType FileEntry::get_compressed_size() const {
+  if (m_payload) {
+    return static_cast<SizeType>(m_payload->data.size());
+  }
   return static_cast<SizeType>(m_compressor->get_length_compressed());
 }
 
+EntryStats FileEntry::get_stats() const {
+  return EntryStats{m_filename,
+                    m_method,
+                    get_uncompressed_size(),
+                    get_compressed_size(),
+                    m_seconds,
+                    m_cached,
+                    m_block_stats};
+}
+
 void FileEntry::write_local_file_header(std::vector<Byte>& buffer) const {
-  const size_t header_length =
-      static_cast<size_t>(30) + get_name_length() + m_length_extra;
-  Byte* content = new Byte[header_length];
-  Byte* p = &content[0];
-
-  marshal_32(p, local_file_header_signature);
-  marshal_16(p, m_ver_extract);
-  marshal_16(p, m_general_purpose);
-  marshal_16(p, static_cast<uint16>(m_method));
-  marshal_16(p, m_last_modify_time.time);
-  marshal_16(p, m_last_modify_time.date);
-  marshal_32(p, m_crc32);
-  marshal_32(p, get_compressed_size());
-  marshal_32(p, get_uncompressed_size());
-  marshal_16(p, get_name_length());
-  marshal_16(p, m_length_extra);
-  marshal_string(p, m_filename);
   assert(m_length_extra == 0);  // No extra field in current implementation
-
-  buffer.insert(buffer.end(), content, content + header_length);
-  delete[] content;
+  sz::write_local_file_header(buffer, make_record(0));
 }
 
 void FileEntry::write_file_block(std::vector<Byte>& buffer) const {
+  if (m_payload) {
+    buffer.insert(buffer.end(), m_payload->data.begin(), m_payload->data.end());
+    return;
+  }
   size_t ed = buffer.size();
   buffer.resize(ed + m_compressor->get_length_compressed());
-  m_compressor->write_result(&buffer[ed]);
+  m_compressor->write_result(buffer.data() + ed);
+}
+
+void FileEntry::write_file_block(const ByteSink& sink) const {
+  if (m_payload) {
+    if (!m_payload->data.empty()) {
+      sink(m_payload->data.data(), m_payload->data.size());
+    }
+    return;
+  }
+  m_compressor->write_result(sink);
 }
 
 void FileEntry::write_central_directory_file_header(
     std::vector<Byte>& buffer, Offset off_local_file_header) const {
-  const size_t header_length = static_cast<size_t>(46) + get_name_length() +
-                               m_length_extra + get_comment_length();
-  Byte* content = new Byte[header_length];
-  Byte* p = &content[0];
-
-  marshal_32(p, central_directory_file_header_signature);
-  marshal_16(p, m_ver_made);
-  marshal_16(p, m_ver_extract);
-  marshal_16(p, m_general_purpose);
-  marshal_16(p, static_cast<uint16>(m_method));
-  marshal_16(p, m_last_modify_time.time);
-  marshal_16(p, m_last_modify_time.date);
-  marshal_32(p, m_crc32);
-  marshal_32(p, get_compressed_size());
-  marshal_32(p, get_uncompressed_size());
-  marshal_16(p, get_name_length());
-  marshal_16(p, m_length_extra);
-  marshal_16(p, get_comment_length());
-  marshal_16(p, m_disk_number);
-  marshal_16(p, m_internal_attr);
-  marshal_32(p, m_external_attr);
-  marshal_32(p, off_local_file_header);
-  marshal_string(p, m_filename);
   assert(m_length_extra == 0);  // No extra field in current implementation
-  marshal_string(p, m_comment);
+  sz::write_central_directory_file_header(buffer,
+                                          make_record(off_local_file_header));
+}
 
-  buffer.insert(buffer.end(), content, content + header_length);
-  delete[] content;
+EntryRecord FileEntry::make_record(const Offset off_local_file_header) const {
+  EntryRecord record{m_ver_made,
+                     m_ver_extract,
+                     m_general_purpose,
+                     m_method,
+                     m_last_modify_time,
+                     m_crc32,
+                     get_compressed_size(),
+                     get_uncompressed_size(),
+                     m_disk_number,
+                     m_internal_attr,
+                     m_external_attr,
+                     off_local_file_header,
+                     m_filename,
+                     m_comment,
+                     false,
+                     {}};
+  if (m_payload) {
+    record.extra = m_payload->extra;
+    return record;
+  }
+  // A single section gains nothing from the index.
+  const auto deflate =
+      std::dynamic_pointer_cast<DeflateCompressor>(m_compressor);
+  if (deflate && deflate->get_sections().size() > 1) {
+    write_section_index(record.extra, deflate->get_sections());
+  }
+  return record;
 }
 
 }  // namespace sz
@@ -0,0 +1,108 @@
+#include "sz/memory.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <iomanip>
+
+namespace sz {
+
+namespace memory {
+
+namespace {
+
+std::array<std::atomic<uint64>, NUses> current_bytes{};
+std::array<std::atomic<uint64>, NUses> peak_bytes{};
+std::atomic<uint64> current_total{0};
+std::atomic<uint64> peak_total{0};
+std::atomic<uint64> budget{0};
+
+void raise_peak(std::atomic<uint64>& peak, const uint64 value) {
+  uint64 old = peak.load(std::memory_order_relaxed);
+  while (old < value && !peak.compare_exchange_weak(old, value)) {
+  }
+}
+
+}  // namespace
+
+const char* use_name(const Use use) {
+  switch (use) {
+    case Use::source:
+      return "source";
+    case Use::lz77:
+      return "lz77";
+    case Use::encoded:
+      return "encoded";
+    case Use::payload:
+      return "payload";
+    case Use::archive:
+      return "archive";
+  }
+  return "";
+}
+
+void charge(const Use use, const uint64 bytes) {
+  if (!bytes) {
+    return;
+  }
+  const auto i = static_cast<size_t>(use);
+  raise_peak(peak_bytes[i], current_bytes[i].fetch_add(bytes) + bytes);
+  raise_peak(peak_total, current_total.fetch_add(bytes) + bytes);
+}
+
+void release(const Use use, const uint64 bytes) {
+  if (!bytes) {
+    return;
+  }
+  current_bytes[static_cast<size_t>(use)].fetch_sub(bytes);
+  current_total.fetch_sub(bytes);
+}
+
+Report report() {
+  Report res{};
+  for (size_t i = 0; i < NUses; ++i) {
+    res.current[i] = current_bytes[i];
+    res.peak[i] = peak_bytes[i];
+  }
+  res.current_total = current_total;
+  res.peak_total = peak_total;
+  return res;
+}
+
+void reset_peaks() {
+  for (size_t i = 0; i < NUses; ++i) {
+    peak_bytes[i] = current_bytes[i].load();
+  }
+  peak_total = current_total.load();
+}
+
+void write_report(std::ostream& os, const Report& report) {
+  const auto mb = [](const uint64 bytes) {
+    return static_cast<double>(bytes) / (1 << 20);
+  };
+  os << std::fixed << std::setprecision(1) << mb(report.peak_total)
+     << " MB (";
+  for (size_t i = 0; i < NUses; ++i) {
+    os << (i ? ", " : "") << use_name(static_cast<Use>(i)) << " "
+       << mb(report.peak[i]);
+  }
+  os << ")";
+}
+
+void set_budget(const uint64 bytes) { budget = bytes; }
+
+uint64 get_budget() { return budget; }
+
+size_t fit_workers(const size_t requested, const uint64 per_worker) {
+  const uint64 limit = budget;
+  if (!limit || !per_worker) {
+    return std::max<size_t>(requested, 1);
+  }
+  const uint64 used = current_total;
+  const uint64 left = limit > used ? limit - used : 0;
+  return static_cast<size_t>(
+      std::clamp<uint64>(left / per_worker, 1, std::max<size_t>(requested, 1)));
+}
+
+}  // namespace memory
+
+}  // namespace sz
@@ -0,0 +1,129 @@
+#include "sz/stats.hpp"
+
+#include <iomanip>
+
+namespace sz {
+
+namespace {
+
+const char* block_type_name(const BlockType type) {
+  switch (type) {
+    case BlockType::store:
+      return "store";
+    case BlockType::static_coding:
+      return "static";
+    case BlockType::dynamic_coding:
+      return "dynamic";
+  }
+  return "";
+}
+
+const char* method_name(const CompressionMethod method) {
+  switch (method) {
+    case CompressionMethod::none:
+      return "store";
+    case CompressionMethod::deflate:
+      return "deflate";
+  }
+  return "";
+}
+
+double average_match(const BlockStats& block) {
+  return block.n_matches ? static_cast<double>(block.match_bytes) /
+                               static_cast<double>(block.n_matches)
+                         : 0.0;
+}
+
+// Write str as a JSON string.
+void write_json_string(std::ostream& os, const std::string& str) {
+  os << '"';
+  for (const char c : str) {
+    if (c == '"' || c == '\\') {
+      os << '\\' << c;
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      os << "\\u" << std::hex << std::setw(4) << std::setfill('0')
+         << static_cast<int>(c) << std::dec << std::setfill(' ');
+    } else {
+      os << c;
+    }
+  }
+  os << '"';
+}
+
+// Write str as a CSV field.
+void write_csv_field(std::ostream& os, const std::string& str) {
+  if (str.find_first_of(",\"\r\n") == std::string::npos) {
+    os << str;
+    return;
+  }
+  os << '"';
+  for (const char c : str) {
+    os << c;
+    if (c == '"') {
+      os << '"';
+    }
+  }
+  os << '"';
+}
+
+}  // namespace
+
+void write_stats_json(std::ostream& os, const std::vector<EntryStats>& stats) {
+  os << std::setprecision(6) << "[";
+  for (size_t i = 0; i < stats.size(); ++i) {
+    const EntryStats& entry = stats[i];
+    os << (i ? ",\n" : "\n") << "  {\"name\":";
+    write_json_string(os, entry.name);
+    os << ",\"method\":\"" << method_name(entry.method)
+       << "\",\"uncompressed_size\":" << entry.uncompressed_size
+       << ",\"compressed_size\":" << entry.compressed_size
+       << ",\"seconds\":" << entry.seconds
+       << ",\"reused\":" << (entry.reused ? "true" : "false")
+       << ",\"blocks\":[";
+    for (size_t j = 0; j < entry.blocks.size(); ++j) {
+      const BlockStats& block = entry.blocks[j];
+      os << (j ? ",\n" : "\n") << "    {\"type\":\""
+         << block_type_name(block.type)
+         << "\",\"input_bytes\":" << block.input_bytes
+         << ",\"output_bits\":" << block.output_bits
+         << ",\"literals\":" << block.n_literals
+         << ",\"matches\":" << block.n_matches
+         << ",\"average_match\":" << average_match(block)
+         << ",\"chain_steps\":" << block.chain_steps
+         << ",\"lz77_seconds\":" << block.lz77_seconds
+         << ",\"encode_seconds\":" << block.encode_seconds << "}";
+    }
+    os << (entry.blocks.empty() ? "]}" : "\n  ]}");
+  }
+  os << (stats.empty() ? "]\n" : "\n]\n");
+}
+
+void write_stats_csv(std::ostream& os, const std::vector<EntryStats>& stats) {
+  os << std::setprecision(6)
+     << "name,method,uncompressed_size,compressed_size,seconds,reused,block,"
+        "type,input_bytes,output_bits,literals,matches,average_match,"
+        "chain_steps,lz77_seconds,encode_seconds\n";
+  for (const EntryStats& entry : stats) {
+    const auto write_entry = [&os, &entry] {
+      write_csv_field(os, entry.name);
+      os << ',' << method_name(entry.method) << ','
+         << entry.uncompressed_size << ',' << entry.compressed_size << ','
+         << entry.seconds << ',' << (entry.reused ? 1 : 0) << ',';
+    };
+    if (entry.blocks.empty()) {
+      write_entry();
+      os << ",,,,,,,,,\n";
+    }
+    for (size_t j = 0; j < entry.blocks.size(); ++j) {
+      const BlockStats& block = entry.blocks[j];
+      write_entry();
+      os << j << ',' << block_type_name(block.type) << ','
+         << block.input_bytes << ',' << block.output_bits << ','
+         << block.n_literals << ',' << block.n_matches << ','
+         << average_match(block) << ',' << block.chain_steps << ','
+         << block.lz77_seconds << ',' << block.encode_seconds << '\n';
+    }
+  }
+}
+
+}  // namespace sz
@@ -0,0 +1,140 @@
+#include "sz/trace.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+
+namespace sz {
+
+namespace trace {
+
+namespace {
+
+// The buffers of all threads that have recorded, those of the threads that
+// have exited, and the time the recording started, which timestamps are
+// relative to.
+struct Registry {
+  std::mutex mtx;
+  std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+  std::vector<std::shared_ptr<ThreadBuffer>> free_buffers;
+  uint64 origin_ns = 0;
+};
+
+Registry& registry() {
+  static Registry reg;
+  return reg;
+}
+
+// The buffer of a thread, handed back when the thread exits. A later thread
+// takes it over, so that workers started for every batch share the lanes of
+// the previous ones instead of adding a lane each.
+struct LocalBuffer {
+  std::shared_ptr<ThreadBuffer> buffer;
+
+  ~LocalBuffer() {
+    if (buffer) {
+      Registry& reg = registry();
+      std::lock_guard lock(reg.mtx);
+      reg.free_buffers.push_back(std::move(buffer));
+    }
+  }
+};
+
+thread_local LocalBuffer local_buffer;
+
+void write_us(std::ostream& os, const uint64 ns) {
+  os << ns / 1000 << '.' << std::setw(3) << std::setfill('0') << ns % 1000;
+}
+
+}  // namespace
+
+void enable() {
+  Registry& reg = registry();
+  {
+    std::lock_guard lock(reg.mtx);
+    for (auto&& buffer : reg.buffers) {
+      buffer->events.clear();
+    }
+    reg.origin_ns = now_ns();
+  }
+#ifndef SZ_DISABLE_TRACE
+  enabled_switch = true;
+#endif
+}
+
+void disable() {
+#ifndef SZ_DISABLE_TRACE
+  enabled_switch = false;
+#endif
+}
+
+ThreadBuffer& thread_buffer() {
+  std::shared_ptr<ThreadBuffer>& buffer = local_buffer.buffer;
+  if (!buffer) {
+    Registry& reg = registry();
+    std::lock_guard lock(reg.mtx);
+    if (reg.free_buffers.empty()) {
+      buffer = std::make_shared<ThreadBuffer>();
+      buffer->tid = static_cast<uint32>(reg.buffers.size() + 1);
+      reg.buffers.push_back(buffer);
+    } else {
+      // The lowest lane, so that the lanes stay packed.
+      auto it = std::min_element(
+          reg.free_buffers.begin(), reg.free_buffers.end(),
+          [](const auto& a, const auto& b) { return a->tid < b->tid; });
+      buffer = std::move(*it);
+      reg.free_buffers.erase(it);
+    }
+  }
+  return *buffer;
+}
+
+void write_json(std::ostream& os) {
+  Registry& reg = registry();
+  std::lock_guard lock(reg.mtx);
+  os << "{\"traceEvents\":[";
+  bool first = true;
+  for (const auto& buffer : reg.buffers) {
+    for (const auto& event : buffer->events) {
+      os << (first ? "\n" : ",\n") << "{\"name\":\"" << event.name
+         << "\",\"cat\":\"sz\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->tid
+         << ",\"ts\":";
+      write_us(os, event.start_ns > reg.origin_ns
+                       ? event.start_ns - reg.origin_ns
+                       : 0);
+      os << ",\"dur\":";
+      write_us(os, event.duration_ns);
+      if (event.bytes) {
+        os << ",\"args\":{\"bytes\":" << event.bytes << "}";
+      }
+      os << "}";
+      first = false;
+    }
+  }
+  os << "\n],\"displayTimeUnit\":\"ms\"}\n";
+}
+
+Session::Session(std::string filename) : m_filename(std::move(filename)) {
+  if (!m_filename.empty()) {
+    enable();
+  }
+}
+
+Session::~Session() {
+  if (m_filename.empty()) {
+    return;
+  }
+  disable();
+  std::ofstream ofs(m_filename);
+  if (!ofs) {
+    std::cerr << "cannot write to file '" << m_filename << "'" << std::endl;
+    return;
+  }
+  write_json(ofs);
+}
+
+}  // namespace trace
+
+}  // namespace sz
@@ -0,0 +1,246 @@
+#include "sz/unzipper.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <mutex>
+#include <set>
+#include <string_view>
+#include <thread>
+
+#include "util/positional_writer.hpp"
+
+namespace sz {
+
+namespace {
+
+// Entries up to this size are decoded into a buffer and written at once.
+// Larger ones are decoded and written chunk by chunk.
+constexpr uint64 UnzipperBufferSize = 4 << 20;
+
+// Whether the entry name stays inside the target directory: it is relative
+// and none of its components is "..".
+bool is_safe_name(const std::string_view name) {
+  if (name.empty() || name.front() == '/' || name.front() == '\\' ||
+      name.find(':') != std::string_view::npos) {
+    return false;
+  }
+  size_t begin = 0;
+  while (begin <= name.size()) {
+    size_t end = name.find_first_of("/\\", begin);
+    if (end == std::string_view::npos) {
+      end = name.size();
+    }
+    if (name.substr(begin, end - begin) == "..") {
+      return false;
+    }
+    begin = end + 1;
+  }
+  return true;
+}
+
+bool is_directory_name(const std::string_view name) {
+  return !name.empty() && name.back() == '/';
+}
+
+// Remove the output file of an entry that failed, which may be truncated or
+// corrupt.
+void remove_output(const std::string& path) {
+  std::error_code ec;
+  std::filesystem::remove(path, ec);
+}
+
+}  // namespace
+
+Unzipper::Unzipper(const ZipReader& reader, const size_t thread_cnt)
+    : m_reader(reader), m_thread_cnt(std::max<size_t>(1, thread_cnt)) {}
+
+UnzipReport Unzipper::extract(const std::vector<std::string>& names,
+                              const std::string& dir) const {
+  UnzipReport report;
+  std::vector<const ZipReader::Entry*> entries;
+  // Entries with a section index, each inflated by all workers together.
+  std::vector<const ZipReader::Entry*> sectioned;
+  const std::filesystem::path root(dir.empty() ? "." : dir);
+
+  // Directories are created up front, so that the workers only create files.
+  std::set<std::filesystem::path> dirs;
+  for (const auto* entry : select(names, report)) {
+    const std::string_view name = m_reader.name(*entry);
+    if (!is_safe_name(name)) {
+      report.failures.emplace_back(name);
+      continue;
+    }
+    const std::filesystem::path path = root / name;
+    if (is_directory_name(name)) {
+      dirs.insert(path);
+      ++report.n_entries;
+      continue;
+    }
+    dirs.insert(path.parent_path());
+    if (entry->n_sections > 1 && m_thread_cnt > 1) {
+      sectioned.push_back(entry);
+    } else {
+      entries.push_back(entry);
+    }
+  }
+  for (const auto& path : dirs) {
+    std::error_code ec;
+    std::filesystem::create_directories(path, ec);
+  }
+
+  for (const auto* entry : sectioned) {
+    const std::string path = (root / m_reader.name(*entry)).string();
+    io::PositionalFileWriter file(path.c_str(), entry->uncompressed_size);
+    if (!file.is_open()) {
+      report.failures.emplace_back(m_reader.name(*entry));
+      continue;
+    }
+    const bool ok = m_reader.extract_parallel(
+        *entry, m_thread_cnt,
+        [&file](const uint64 off, const Byte* data, size_t n) {
+          file.write_at(off, data, n);
+        });
+    if (file.close() && ok) {
+      ++report.n_entries;
+      report.n_bytes += entry->uncompressed_size;
+    } else {
+      remove_output(path);
+      report.failures.emplace_back(m_reader.name(*entry));
+    }
+  }
+
+  std::vector<std::vector<Byte>> buffers(m_thread_cnt);
+  for_each(
+      std::move(entries),
+      [this, &root, &buffers](const ZipReader::Entry& entry, size_t worker) {
+        const std::string path = (root / m_reader.name(entry)).string();
+        io::PositionalFileWriter file(path.c_str(), entry.uncompressed_size);
+        if (!file.is_open()) {
+          return false;
+        }
+
+        bool ok = false;
+        if (entry.uncompressed_size <= UnzipperBufferSize) {
+          std::vector<Byte>& buffer = buffers[worker];
+          buffer.resize(entry.uncompressed_size);
+          ok = m_reader.extract(entry, buffer.data()) &&
+               file.write_at(0, buffer.data(), buffer.size());
+        } else {
+          uint64 off = 0;
+          bool written = true;
+          ok = m_reader.extract(
+              entry, [&file, &off, &written, &entry](const Byte* data,
+                                                     size_t n) {
+                // The length is checked by the reader, but the file must not
+                // be written past its size before that.
+                if (written && off + n <= entry.uncompressed_size) {
+                  written = file.write_at(off, data, n);
+                }
+                off += n;
+              });
+          ok = ok && written;
+        }
+        if (!file.close() || !ok) {
+          remove_output(path);
+          return false;
+        }
+        return true;
+      },
+      report);
+  return report;
+}
+
+UnzipReport Unzipper::test(const std::vector<std::string>& names) const {
+  UnzipReport report;
+  std::vector<const ZipReader::Entry*> entries;
+  for (const auto* entry : select(names, report)) {
+    if (entry->n_sections > 1 && m_thread_cnt > 1) {
+      // Inflated by all workers together.
+      if (m_reader.extract_parallel(*entry, m_thread_cnt,
+                                    [](uint64, const Byte*, size_t) {})) {
+        ++report.n_entries;
+        report.n_bytes += entry->uncompressed_size;
+      } else {
+        report.failures.emplace_back(m_reader.name(*entry));
+      }
+    } else {
+      entries.push_back(entry);
+    }
+  }
+
+  std::vector<std::vector<Byte>> buffers(m_thread_cnt);
+  for_each(
+      std::move(entries),
+      [this, &buffers](const ZipReader::Entry& entry, size_t worker) {
+        if (entry.uncompressed_size <= UnzipperBufferSize) {
+          std::vector<Byte>& buffer = buffers[worker];
+          buffer.resize(entry.uncompressed_size);
+          return m_reader.extract(entry, buffer.data());
+        }
+        return m_reader.extract(entry, [](const Byte*, size_t) {});
+      },
+      report);
+  return report;
+}
+
+std::vector<const ZipReader::Entry*> Unzipper::select(
+    const std::vector<std::string>& names, UnzipReport& report) const {
+  std::vector<const ZipReader::Entry*> entries;
+  if (names.empty()) {
+    for (const auto& entry : m_reader.entries()) {
+      entries.push_back(&entry);
+    }
+    return entries;
+  }
+  for (const auto& name : names) {
+    const auto* entry = m_reader.find(name);
+    if (entry) {
+      entries.push_back(entry);
+    } else {
+      report.failures.push_back(name);
+    }
+  }
+  return entries;
+}
+
+template <typename Fn>
+void Unzipper::for_each(std::vector<const ZipReader::Entry*> entries, Fn fn,
+                        UnzipReport& report) const {
+  std::stable_sort(entries.begin(), entries.end(),
+                   [](const ZipReader::Entry* a, const ZipReader::Entry* b) {
+                     return a->compressed_size > b->compressed_size;
+                   });
+
+  std::atomic<size_t> next(0);
+  std::atomic<size_t> n_entries(0);
+  std::atomic<uint64> n_bytes(0);
+  std::mutex mtx;
+  auto work_thread = [&](const size_t worker) {
+    for (size_t k; (k = next.fetch_add(1)) < entries.size();) {
+      const ZipReader::Entry& entry = *entries[k];
+      if (fn(entry, worker)) {
+        ++n_entries;
+        n_bytes += entry.uncompressed_size;
+      } else {
+        std::lock_guard lock(mtx);
+        report.failures.emplace_back(m_reader.name(entry));
+      }
+    }
+  };
+
+  const size_t worker_cnt = std::min(m_thread_cnt, entries.size());
+  std::vector<std::thread> workers;
+  for (size_t i = 1; i < worker_cnt; ++i) {
+    workers.emplace_back(work_thread, i);
+  }
+  work_thread(0);
+  for (auto& worker : workers) {
+    worker.join();
+  }
+
+  report.n_entries += n_entries;
+  report.n_bytes += n_bytes;
+}
+
+}  // namespace sz
@@ -6,5 +6,9 @@ namespace sz {
 
 constexpr OptVersion Version = 0x003F;
 constexpr OptVersion ExtractVersion = 0x000A;
+// Version 2.0 is needed to extract entries with data descriptor.
+constexpr OptVersion DataDescriptorExtractVersion = 0x0014;
+// Version 4.5 is needed to extract entries or archives in ZIP64 format.
+constexpr OptVersion Zip64ExtractVersion = 0x002D;
 
 }  // namespace sz
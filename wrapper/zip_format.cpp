@@ -0,0 +1,213 @@
+#include "wrapper/zip_format.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#include "compress/cps_deflate.hpp"
+#include "util/byte_util.hpp"
+#include "wrapper/constants.hpp"
+#include "wrapper/version.hpp"
+
+namespace sz {
+
+namespace {
+
+// Value of a 4-byte field whose content is moved to the ZIP64 extra field.
+constexpr uint32 Zip64Placeholder32 = 0xFFFFFFFF;
+constexpr uint16 Zip64Placeholder16 = 0xFFFF;
+
+[[nodiscard]] bool overflow_32(const uint64 x) {
+  return x >= Zip64SizeThreshold;
+}
+
+// Write x into a 4-byte field, or the placeholder if x is in the extra field.
+void marshal_32_or_zip64(Byte*& p, const uint64 x) {
+  marshal_32(p, overflow_32(x) ? Zip64Placeholder32 : static_cast<uint32>(x));
+}
+
+}  // namespace
+
+bool zip64_sizes(const EntryRecord& record) {
+  return overflow_32(record.compressed_size) ||
+         overflow_32(record.uncompressed_size);
+}
+
+void write_local_file_header(std::vector<Byte>& buffer,
+                             const EntryRecord& record) {
+  const bool descriptor = record.general_purpose & GeneralPurposeDataDescriptor;
+  const bool zip64 = record.zip64 || (!descriptor && zip64_sizes(record));
+  // Both sizes must be present in the extra field of a local file header.
+  const size_t extra_length = zip64 ? 20 : 0;
+  const size_t header_length =
+      static_cast<size_t>(30) + record.filename.length() + extra_length;
+  const size_t ed = buffer.size();
+  buffer.resize(ed + header_length);
+  Byte* p = &buffer[ed];
+
+  const uint64 compressed_size = descriptor ? 0 : record.compressed_size;
+  const uint64 uncompressed_size = descriptor ? 0 : record.uncompressed_size;
+
+  marshal_32(p, local_file_header_signature);
+  marshal_16(p, zip64 ? std::max(record.ver_extract, Zip64ExtractVersion)
+                      : record.ver_extract);
+  marshal_16(p, record.general_purpose);
+  marshal_16(p, static_cast<uint16>(record.method));
+  marshal_16(p, record.last_modify_time.time);
+  marshal_16(p, record.last_modify_time.date);
+  marshal_32(p, descriptor ? 0 : record.crc32);
+  marshal_32(p, zip64 ? Zip64Placeholder32
+                      : static_cast<uint32>(compressed_size));
+  marshal_32(p, zip64 ? Zip64Placeholder32
+                      : static_cast<uint32>(uncompressed_size));
+  marshal_16(p, static_cast<LengthType>(record.filename.length()));
+  marshal_16(p, static_cast<LengthType>(extra_length));
+  marshal_string(p, record.filename);
+  if (zip64) {
+    marshal_16(p, Zip64ExtraFieldId);
+    marshal_16(p, 16);
+    marshal_64(p, uncompressed_size);
+    marshal_64(p, compressed_size);
+  }
+}
+
+void write_data_descriptor(std::vector<Byte>& buffer,
+                           const EntryRecord& record) {
+  const size_t descriptor_length = record.zip64 ? 24 : 16;
+  const size_t ed = buffer.size();
+  buffer.resize(ed + descriptor_length);
+  Byte* p = &buffer[ed];
+
+  marshal_32(p, data_descriptor_signature);
+  marshal_32(p, record.crc32);
+  if (record.zip64) {
+    marshal_64(p, record.compressed_size);
+    marshal_64(p, record.uncompressed_size);
+  } else {
+    marshal_32(p, static_cast<uint32>(record.compressed_size));
+    marshal_32(p, static_cast<uint32>(record.uncompressed_size));
+  }
+}
+
+void write_central_directory_file_header(std::vector<Byte>& buffer,
+                                         const EntryRecord& record) {
+  // Only the fields that do not fit appear in the extra field, in this order.
+  const bool zip64_uncompressed = overflow_32(record.uncompressed_size);
+  const bool zip64_compressed = overflow_32(record.compressed_size);
+  const bool zip64_offset = overflow_32(record.off_local_file_header);
+  const size_t zip64_data_length =
+      8 * (static_cast<size_t>(zip64_uncompressed) + zip64_compressed +
+           zip64_offset);
+  const size_t zip64_length = zip64_data_length ? 4 + zip64_data_length : 0;
+  const size_t extra_length = zip64_length + record.extra.size();
+  const bool zip64 = record.zip64 || zip64_length;
+
+  const size_t header_length = static_cast<size_t>(46) +
+                               record.filename.length() + extra_length +
+                               record.comment.length();
+  const size_t ed = buffer.size();
+  buffer.resize(ed + header_length);
+  Byte* p = &buffer[ed];
+
+  marshal_32(p, central_directory_file_header_signature);
+  marshal_16(p, record.ver_made);
+  marshal_16(p, zip64 ? std::max(record.ver_extract, Zip64ExtractVersion)
+                      : record.ver_extract);
+  marshal_16(p, record.general_purpose);
+  marshal_16(p, static_cast<uint16>(record.method));
+  marshal_16(p, record.last_modify_time.time);
+  marshal_16(p, record.last_modify_time.date);
+  marshal_32(p, record.crc32);
+  marshal_32_or_zip64(p, record.compressed_size);
+  marshal_32_or_zip64(p, record.uncompressed_size);
+  marshal_16(p, static_cast<LengthType>(record.filename.length()));
+  marshal_16(p, static_cast<LengthType>(extra_length));
+  marshal_16(p, static_cast<LengthType>(record.comment.length()));
+  marshal_16(p, record.disk_number);
+  marshal_16(p, record.internal_attr);
+  marshal_32(p, record.external_attr);
+  marshal_32_or_zip64(p, record.off_local_file_header);
+  marshal_string(p, record.filename);
+  if (zip64_length) {
+    marshal_16(p, Zip64ExtraFieldId);
+    marshal_16(p, static_cast<uint16>(zip64_data_length));
+    if (zip64_uncompressed) {
+      marshal_64(p, record.uncompressed_size);
+    }
+    if (zip64_compressed) {
+      marshal_64(p, record.compressed_size);
+    }
+    if (zip64_offset) {
+      marshal_64(p, record.off_local_file_header);
+    }
+  }
+  if (!record.extra.empty()) {
+    memcpy(p, record.extra.data(), record.extra.size());
+    p += record.extra.size();
+  }
+  marshal_string(p, record.comment);
+}
+
+void write_section_index(std::vector<Byte>& extra,
+                         const std::vector<DeflateSection>& sections) {
+  const size_t data_length = 4 + 16 * sections.size();
+  const size_t ed = extra.size();
+  extra.resize(ed + 4 + data_length);
+  Byte* p = &extra[ed];
+
+  marshal_16(p, SectionIndexExtraFieldId);
+  marshal_16(p, static_cast<uint16>(data_length));
+  marshal_32(p, static_cast<uint32>(sections.size()));
+  for (const auto& section : sections) {
+    marshal_64(p, section.compressed_len);
+    marshal_64(p, section.uncompressed_len);
+  }
+}
+
+void write_eocd(std::vector<Byte>& buffer, const size_t n_entries,
+                const uint64 off_cd, const uint64 len_cd,
+                const std::string& comment) {
+  const bool zip64_entries = n_entries >= Zip64EntriesThreshold;
+  const bool zip64 =
+      zip64_entries || overflow_32(off_cd) || overflow_32(len_cd);
+
+  const size_t header_length =
+      static_cast<size_t>(22) + (zip64 ? 56 + 20 : 0) + comment.length();
+  const size_t ed = buffer.size();
+  buffer.resize(ed + header_length);
+  Byte* p = &buffer[ed];
+
+  if (zip64) {
+    // ZIP64 end of central directory record
+    marshal_32(p, zip64_endof_central_directory_signature);
+    marshal_64(p, 44);  // Size of the remaining record
+    marshal_16(p, Version);
+    marshal_16(p, Zip64ExtractVersion);
+    marshal_32(p, 0);  // Number of this disk
+    marshal_32(p, 0);  // Disk where central directory starts
+    marshal_64(p, n_entries);
+    marshal_64(p, n_entries);
+    marshal_64(p, len_cd);
+    marshal_64(p, off_cd);
+
+    // ZIP64 end of central directory locator
+    marshal_32(p, zip64_endof_central_directory_locator_signature);
+    marshal_32(p, 0);  // Disk where ZIP64 end of central directory starts
+    marshal_64(p, off_cd + len_cd);
+    marshal_32(p, 1);  // Total number of disks
+  }
+
+  marshal_32(p, endof_central_directory_file_header_signature);
+  marshal_16(p, 0);  // Number of this disk
+  marshal_16(p, 0);  // Disk where central directory starts
+  // Use the number of entries directly as number of central directory records
+  const NRecord n_records = zip64_entries ? Zip64Placeholder16
+                                          : static_cast<NRecord>(n_entries);
+  marshal_16(p, n_records);
+  marshal_16(p, n_records);
+  marshal_32_or_zip64(p, len_cd);
+  marshal_32_or_zip64(p, off_cd);
+  marshal_16(p, static_cast<LengthType>(comment.length()));
+  marshal_string(p, comment);
+}
+
+}  // namespace sz
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "sz/types.hpp"
+
+namespace sz {
+
+struct DeflateSection;
+
+// General purpose bit 3: crc-32 and sizes are stored in the data descriptor
+// following the file data instead of the local file header.
+constexpr GeneralPurpose GeneralPurposeDataDescriptor = 0x0008;
+
+// A 4-byte size or offset at or above this value is written as 0xFFFFFFFF
+// and stored in the ZIP64 extended information extra field instead.
+constexpr uint64 Zip64SizeThreshold = 0xFFFFFFFF;
+// An entry count at or above this value needs the ZIP64 end of central
+// directory record.
+constexpr uint64 Zip64EntriesThreshold = 0xFFFF;
+// Header ID of the ZIP64 extended information extra field.
+constexpr uint16 Zip64ExtraFieldId = 0x0001;
+// Header ID of the private extra field that lists the sections of a deflate
+// entry, so that they can be inflated in parallel. Other tools skip it.
+constexpr uint16 SectionIndexExtraFieldId = 0x5A53;
+
+// All fields of an entry that appear in its local file header and its
+// central directory file header.
+struct EntryRecord {
+  OptVersion ver_made;
+  OptVersion ver_extract;
+  GeneralPurpose general_purpose;
+  CompressionMethod method;
+  Timestamp last_modify_time;
+  CRC32Value crc32;
+  SizeType compressed_size;
+  SizeType uncompressed_size;
+  DiskNumber disk_number;
+  InternalAttr internal_attr;
+  ExternalAttr external_attr;
+  // Offset of the local file header from the start of the archive.
+  Offset off_local_file_header;
+  std::string filename;
+  std::string comment;
+  // Write the local file header and the data descriptor in ZIP64 format even
+  // if the sizes are small. Needed when the sizes are not known in advance
+  // but may reach Zip64SizeThreshold.
+  bool zip64;
+  // Extra fields of the central directory file header besides the ZIP64 one.
+  std::vector<Byte> extra;
+};
+
+// Whether the sizes of the entry do not fit in the 4-byte fields.
+[[nodiscard]] bool zip64_sizes(const EntryRecord& record);
+
+// Append the local file header of the entry to buffer.
+// If the data descriptor flag is set, crc-32 and sizes are written as 0.
+// The ZIP64 extra field is added if the sizes need it or record.zip64 is set.
+void write_local_file_header(std::vector<Byte>& buffer,
+                             const EntryRecord& record);
+
+// Append the data descriptor of the entry to buffer.
+// Sizes are written in 8 bytes if record.zip64 is set.
+void write_data_descriptor(std::vector<Byte>& buffer,
+                           const EntryRecord& record);
+
+// Append the central directory file header of the entry to buffer.
+// The sizes and the offset that do not fit are moved to the ZIP64 extra field.
+void write_central_directory_file_header(std::vector<Byte>& buffer,
+                                         const EntryRecord& record);
+
+// Append the section index extra field of the sections to extra:
+// the number of sections (4 bytes), then the compressed and the uncompressed
+// length of each section (8 bytes each).
+void write_section_index(std::vector<Byte>& extra,
+                         const std::vector<DeflateSection>& sections);
+
+// Append the end of central directory record to buffer. The central directory
+// must end right where the record starts.
+// If the number of entries, the offset or the length of the central directory
+// does not fit, the ZIP64 end of central directory record and its locator are
+// written before it.
+void write_eocd(std::vector<Byte>& buffer, size_t n_entries, uint64 off_cd,
+                uint64 len_cd, const std::string& comment);
+
+}  // namespace sz
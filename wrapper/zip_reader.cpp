@@ -0,0 +1,491 @@
+#include "sz/zip_reader.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <initializer_list>
+#include <thread>
+
+#include "compress/dps_inflate.hpp"
+#include "compress/dps_store.hpp"
+#include "crc/crc32.hpp"
+#include "util/byte_util.hpp"
+#include "util/mapped_file.hpp"
+#include "wrapper/constants.hpp"
+#include "wrapper/zip_format.hpp"
+
+namespace sz {
+
+namespace {
+
+constexpr uint64 EOCDLength = 22;
+constexpr uint64 Zip64EOCDLength = 56;
+constexpr uint64 Zip64EOCDLocatorLength = 20;
+constexpr uint64 CDFileHeaderLength = 46;
+constexpr uint64 LocalFileHeaderLength = 30;
+constexpr uint64 EOCDCommentMaxLength = 0xFFFF;
+
+// Compressed bytes pushed to a stream decoder at a time.
+constexpr size_t ZipReaderChunkSize = 1 << 20;
+
+// Return the decoder of the method, or nullptr if it is not supported.
+std::unique_ptr<Decompressor> make_decoder(const CompressionMethod method) {
+  switch (method) {
+    case CompressionMethod::none:
+      return std::make_unique<StoreDecoder>();
+    case CompressionMethod::deflate:
+      return std::make_unique<InflateDecoder>();
+  }
+  return nullptr;
+}
+
+// FNV-1a hash of the name.
+uint64 hash_name(std::string_view name) {
+  uint64 h = 14695981039346656037ull;
+  for (const char c : name) {
+    h = (h ^ static_cast<Byte>(c)) * 1099511628211ull;
+  }
+  return h;
+}
+
+}  // namespace
+
+ZipReader::ZipReader(const char* filename)
+    : m_file(std::make_shared<io::MappedFile>(filename)), m_open(false) {
+  m_open = m_file->is_open() && parse();
+  if (m_open) {
+    build_index();
+  } else {
+    m_entries.clear();
+  }
+}
+
+ZipReader::~ZipReader() = default;
+
+std::string_view ZipReader::name(const Entry& entry) const {
+  return std::string_view(
+      reinterpret_cast<const char*>(m_file->data() + entry.off_name),
+      entry.name_length);
+}
+
+const ZipReader::Entry* ZipReader::find(const std::string_view name) const {
+  if (m_slots.empty()) {
+    return nullptr;
+  }
+  const uint64 h = hash_name(name);
+  const auto tag = static_cast<uint32>(h >> 32);
+  const size_t mask = m_slots.size() - 1;
+  for (size_t i = h & mask;; i = (i + 1) & mask) {
+    const Slot& slot = m_slots[i];
+    if (slot.index == EmptySlot) {
+      return nullptr;
+    }
+    if (slot.tag == tag) {
+      const Entry& entry = m_entries[slot.index];
+      if (this->name(entry) == name) {
+        return &entry;
+      }
+    }
+  }
+}
+
+const Byte* ZipReader::data(const Entry& entry) const {
+  const uint64 size = m_file->size();
+  if (entry.off_local_file_header > size ||
+      size - entry.off_local_file_header < LocalFileHeaderLength) {
+    return nullptr;
+  }
+  const Byte* p = m_file->data() + entry.off_local_file_header;
+  if (unmarshal_32(p) != local_file_header_signature) {
+    return nullptr;
+  }
+  p += 22;
+  const uint64 name_length = unmarshal_16(p);
+  const uint64 extra_length = unmarshal_16(p);
+  const uint64 off_data = entry.off_local_file_header + LocalFileHeaderLength +
+                          name_length + extra_length;
+  if (off_data > size || size - off_data < entry.compressed_size) {
+    return nullptr;
+  }
+  return m_file->data() + off_data;
+}
+
+bool ZipReader::extract(const Entry& entry, Byte* dst) const {
+  const Byte* src = data(entry);
+  const auto decoder = make_decoder(entry.method);
+  if (!src || !decoder ||
+      !decoder->decompress(src, entry.compressed_size, dst,
+                           entry.uncompressed_size)) {
+    return false;
+  }
+  return crc32::calculate(dst, entry.uncompressed_size) == entry.crc32;
+}
+
+bool ZipReader::extract(const Entry& entry, const ByteSink& sink) const {
+  const Byte* src = data(entry);
+  const auto decoder = make_decoder(entry.method);
+  if (!src || !decoder) {
+    return false;
+  }
+  CRC32Value crc = 0;
+  uint64 len = 0;
+  decoder->begin([&crc, &len, &sink](const Byte* data, size_t n) {
+    crc = crc32::extend(crc, data, n);
+    len += n;
+    sink(data, n);
+  });
+  bool ok = true;
+  for (uint64 off = 0; ok && off < entry.compressed_size;
+       off += ZipReaderChunkSize) {
+    const auto n = static_cast<size_t>(
+        std::min<uint64>(ZipReaderChunkSize, entry.compressed_size - off));
+    ok = decoder->push(src + off, n);
+  }
+  ok = decoder->finish() && ok;
+  return ok && len == entry.uncompressed_size && crc == entry.crc32;
+}
+
+bool ZipReader::read(const Entry& entry, const uint64 off, const size_t len,
+                     Byte* dst) const {
+  if (off > entry.uncompressed_size || entry.uncompressed_size - off < len) {
+    return false;
+  }
+  const Byte* src = data(entry);
+  if (!src) {
+    return false;
+  }
+  if (len == 0) {
+    return true;
+  }
+  if (entry.method == CompressionMethod::none) {
+    memcpy(dst, src + off, len);
+    return true;
+  }
+  if (entry.n_sections == 0) {
+    return read_stream(entry, src, off, len, dst);
+  }
+
+  // Decode the sections overlapping [off, off + len), each only as far as
+  // needed.
+  const uint64 end = off + len;
+  uint64 off_compressed = 0;
+  uint64 off_uncompressed = 0;
+  InflateDecoder decoder;
+  std::vector<Byte> buffer;
+  const Byte* p = m_file->data() + entry.off_sections;
+  for (uint32 i = 0; i < entry.n_sections && off_uncompressed < end; ++i) {
+    const uint64 compressed_len = unmarshal_64(p);
+    const uint64 uncompressed_len = unmarshal_64(p);
+    if (off < off_uncompressed + uncompressed_len) {
+      const uint64 lo = std::max(off, off_uncompressed);
+      const uint64 hi = std::min(end, off_uncompressed + uncompressed_len);
+      buffer.resize(static_cast<size_t>(uncompressed_len));
+      if (!decoder.decompress_prefix(
+              src + off_compressed, static_cast<size_t>(compressed_len),
+              buffer.data(), buffer.size(),
+              static_cast<size_t>(hi - off_uncompressed))) {
+        return false;
+      }
+      memcpy(dst + (lo - off), buffer.data() + (lo - off_uncompressed),
+             static_cast<size_t>(hi - lo));
+    }
+    off_compressed += compressed_len;
+    off_uncompressed += uncompressed_len;
+  }
+  return true;
+}
+
+bool ZipReader::read_stream(const Entry& entry, const Byte* src,
+                            const uint64 off, const size_t len,
+                            Byte* dst) const {
+  const auto decoder = make_decoder(entry.method);
+  if (!decoder) {
+    return false;
+  }
+  // Keep only the part of the output within [off, end).
+  const uint64 end = off + len;
+  uint64 pos = 0;
+  decoder->begin([off, end, dst, &pos](const Byte* data, size_t n) {
+    const uint64 lo = std::max(pos, off);
+    const uint64 hi = std::min(pos + n, end);
+    if (lo < hi) {
+      memcpy(dst + (lo - off), data + (lo - pos), hi - lo);
+    }
+    pos += n;
+  });
+  for (uint64 i = 0; pos < end && i < entry.compressed_size;
+       i += ZipReaderChunkSize) {
+    const auto n = static_cast<size_t>(
+        std::min<uint64>(ZipReaderChunkSize, entry.compressed_size - i));
+    if (!decoder->push(src + i, n)) {
+      return false;
+    }
+  }
+  if (pos < end && !decoder->finish()) {
+    return false;
+  }
+  return pos >= end;
+}
+
+bool ZipReader::extract_parallel(const Entry& entry, const size_t thread_cnt,
+                                 const PositionalSink& sink) const {
+  if (entry.n_sections == 0 || entry.method != CompressionMethod::deflate) {
+    uint64 off = 0;
+    return extract(entry, [&off, &sink](const Byte* data, size_t n) {
+      sink(off, data, n);
+      off += n;
+    });
+  }
+  const Byte* src = data(entry);
+  if (!src) {
+    return false;
+  }
+
+  struct Section {
+    uint64 off_compressed;
+    uint64 compressed_len;
+    uint64 off_uncompressed;
+    uint64 uncompressed_len;
+    CRC32Value crc32;
+  };
+  std::vector<Section> sections(entry.n_sections);
+  const Byte* p = m_file->data() + entry.off_sections;
+  uint64 off_compressed = 0;
+  uint64 off_uncompressed = 0;
+  for (auto& section : sections) {
+    section.off_compressed = off_compressed;
+    section.compressed_len = unmarshal_64(p);
+    section.off_uncompressed = off_uncompressed;
+    section.uncompressed_len = unmarshal_64(p);
+    off_compressed += section.compressed_len;
+    off_uncompressed += section.uncompressed_len;
+  }
+
+  std::atomic<size_t> next(0);
+  std::atomic<bool> failed(false);
+  auto work_thread = [&]() {
+    InflateDecoder decoder;
+    std::vector<Byte> buffer;
+    for (size_t k; !failed && (k = next.fetch_add(1)) < sections.size();) {
+      Section& section = sections[k];
+      buffer.resize(static_cast<size_t>(section.uncompressed_len));
+      if (!decoder.decompress_section(
+              src + section.off_compressed,
+              static_cast<size_t>(section.compressed_len), buffer.data(),
+              buffer.size(), k + 1 == sections.size())) {
+        failed = true;
+        break;
+      }
+      section.crc32 = crc32::calculate(buffer.data(), buffer.size());
+      sink(section.off_uncompressed, buffer.data(), buffer.size());
+    }
+  };
+
+  const size_t worker_cnt =
+      std::min(std::max<size_t>(thread_cnt, 1), sections.size());
+  std::vector<std::thread> workers;
+  for (size_t i = 1; i < worker_cnt; ++i) {
+    workers.emplace_back(work_thread);
+  }
+  work_thread();
+  for (auto& worker : workers) {
+    worker.join();
+  }
+  if (failed) {
+    return false;
+  }
+
+  CRC32Value crc = 0;
+  for (const auto& section : sections) {
+    crc = crc32::combine(crc, section.crc32, section.uncompressed_len);
+  }
+  return crc == entry.crc32;
+}
+
+bool ZipReader::parse() {
+  const uint64 size = m_file->size();
+  const Byte* base = m_file->data();
+  if (size < EOCDLength) {
+    return false;
+  }
+
+  // The end of central directory record is followed by a comment of at most
+  // 65535 bytes, so it is searched backwards from the end.
+  const uint64 lowest =
+      size - EOCDLength > EOCDCommentMaxLength
+          ? size - EOCDLength - EOCDCommentMaxLength
+          : 0;
+  uint64 off_eocd = size - EOCDLength;
+  while (true) {
+    const Byte* p = base + off_eocd;
+    if (unmarshal_32(p) == endof_central_directory_file_header_signature) {
+      p += 16;
+      if (off_eocd + EOCDLength + unmarshal_16(p) <= size) {
+        break;
+      }
+    }
+    if (off_eocd == lowest) {
+      return false;
+    }
+    --off_eocd;
+  }
+
+  const Byte* p = base + off_eocd + 10;
+  uint64 n_entries = unmarshal_16(p);
+  uint64 len_cd = unmarshal_32(p);
+  uint64 off_cd = unmarshal_32(p);
+  uint64 off_end_cd = off_eocd;
+
+  // The ZIP64 end of central directory locator, if any, is right before the
+  // end of central directory record.
+  if (off_eocd >= Zip64EOCDLocatorLength) {
+    p = base + off_eocd - Zip64EOCDLocatorLength;
+    if (unmarshal_32(p) == zip64_endof_central_directory_locator_signature) {
+      p += 4;
+      const uint64 off_zip64_eocd = unmarshal_64(p);
+      if (off_zip64_eocd > off_eocd - Zip64EOCDLocatorLength ||
+          off_eocd - Zip64EOCDLocatorLength - off_zip64_eocd <
+              Zip64EOCDLength) {
+        return false;
+      }
+      p = base + off_zip64_eocd;
+      if (unmarshal_32(p) != zip64_endof_central_directory_signature) {
+        return false;
+      }
+      p += 20;
+      n_entries = unmarshal_64(p);
+      (void)unmarshal_64(p);  // Total number of entries on all disks
+      len_cd = unmarshal_64(p);
+      off_cd = unmarshal_64(p);
+      off_end_cd = off_zip64_eocd;
+    }
+  }
+
+  if (off_cd > off_end_cd || off_end_cd - off_cd < len_cd) {
+    return false;
+  }
+  return parse_central_directory(off_cd, len_cd, n_entries);
+}
+
+bool ZipReader::parse_central_directory(const uint64 off_cd,
+                                        const uint64 len_cd,
+                                        const uint64 n_entries) {
+  // Every header takes at least 46 bytes, which bounds a bogus count.
+  if (n_entries > len_cd / CDFileHeaderLength) {
+    return false;
+  }
+  m_entries.resize(static_cast<size_t>(n_entries));
+
+  const Byte* base = m_file->data();
+  uint64 off = off_cd;
+  const uint64 off_end = off_cd + len_cd;
+  for (auto& entry : m_entries) {
+    if (off_end - off < CDFileHeaderLength) {
+      return false;
+    }
+    const Byte* p = base + off;
+    if (unmarshal_32(p) != central_directory_file_header_signature) {
+      return false;
+    }
+    p += 4;  // Version made by, version needed to extract
+    entry.general_purpose = unmarshal_16(p);
+    entry.method = static_cast<CompressionMethod>(unmarshal_16(p));
+    entry.last_modify_time.time = unmarshal_16(p);
+    entry.last_modify_time.date = unmarshal_16(p);
+    entry.crc32 = unmarshal_32(p);
+    entry.compressed_size = unmarshal_32(p);
+    entry.uncompressed_size = unmarshal_32(p);
+    entry.name_length = unmarshal_16(p);
+    const uint64 extra_length = unmarshal_16(p);
+    const uint64 comment_length = unmarshal_16(p);
+    p += 8;  // Disk number, internal and external attributes
+    entry.off_local_file_header = unmarshal_32(p);
+
+    const uint64 header_length = CDFileHeaderLength + entry.name_length +
+                                 extra_length + comment_length;
+    if (off_end - off < header_length) {
+      return false;
+    }
+    entry.off_cd_header = off;
+    entry.off_name = off + CDFileHeaderLength;
+    entry.off_sections = 0;
+    entry.n_sections = 0;
+
+    // Take the fields that do not fit from the ZIP64 extra field.
+    p = base + entry.off_name + entry.name_length;
+    const Byte* extra_end = p + extra_length;
+    while (extra_end - p >= 4) {
+      const uint16 id = unmarshal_16(p);
+      const uint16 length = unmarshal_16(p);
+      if (extra_end - p < length) {
+        return false;
+      }
+      if (id == Zip64ExtraFieldId) {
+        const Byte* q = p;
+        const Byte* field_end = p + length;
+        for (SizeType* field :
+             {&entry.uncompressed_size, &entry.compressed_size,
+              &entry.off_local_file_header}) {
+          if (*field == Zip64SizeThreshold) {
+            if (field_end - q < 8) {
+              return false;
+            }
+            *field = unmarshal_64(q);
+          }
+        }
+      } else if (id == SectionIndexExtraFieldId && length >= 4) {
+        const Byte* q = p;
+        const uint32 n_sections = unmarshal_32(q);
+        if (length == 4 + 16ull * n_sections) {
+          entry.off_sections = q - base;
+          entry.n_sections = n_sections;
+        }
+      }
+      p += length;
+    }
+    // The index is only a hint, so one that does not match is ignored.
+    if (entry.n_sections && !check_sections(entry)) {
+      entry.n_sections = 0;
+    }
+
+    off += header_length;
+  }
+  return true;
+}
+
+bool ZipReader::check_sections(const Entry& entry) const {
+  const Byte* p = m_file->data() + entry.off_sections;
+  uint64 compressed_left = entry.compressed_size;
+  uint64 uncompressed_left = entry.uncompressed_size;
+  for (uint32 i = 0; i < entry.n_sections; ++i) {
+    const uint64 compressed_len = unmarshal_64(p);
+    const uint64 uncompressed_len = unmarshal_64(p);
+    if (compressed_len > compressed_left ||
+        uncompressed_len > uncompressed_left) {
+      return false;
+    }
+    compressed_left -= compressed_len;
+    uncompressed_left -= uncompressed_len;
+  }
+  return compressed_left == 0 && uncompressed_left == 0;
+}
+
+void ZipReader::build_index() {
+  // Keep the load factor at most 1/2, so that probe sequences stay short.
+  size_t n_slots = 2;
+  while (n_slots < 2 * m_entries.size()) {
+    n_slots <<= 1;
+  }
+  m_slots.assign(n_slots, Slot{0, EmptySlot});
+  const size_t mask = n_slots - 1;
+  for (size_t i = 0; i < m_entries.size(); ++i) {
+    const uint64 h = hash_name(name(m_entries[i]));
+    size_t k = h & mask;
+    while (m_slots[k].index != EmptySlot) {
+      k = (k + 1) & mask;
+    }
+    m_slots[k] = Slot{static_cast<uint32>(h >> 32), static_cast<uint32>(i)};
+  }
+}
+
+}  // namespace sz
@@ -0,0 +1,369 @@
+#include "sz/zip_writer.hpp"
+
+#include <algorithm>
+#include <chrono>
+
+#ifndef WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "sz/common.hpp"
+#include "sz/log.hpp"
+#include "sz/trace.hpp"
+
+#include "compress/compressor.hpp"
+#include "compress/cps_deflate.hpp"
+#include "compress/cps_store.hpp"
+#include "crc/crc32.hpp"
+#include "util/async_writer.hpp"
+#include "util/fs.hpp"
+#include "util/mapped_file.hpp"
+#include "wrapper/version.hpp"
+#include "wrapper/zip_format.hpp"
+
+namespace sz {
+
+// Bytes read from the source file at a time.
+constexpr size_t ZipWriterReadChunkSize = 1 << 20;
+// Maximum bytes waiting to be written to the target file.
+constexpr size_t ZipWriterMaxPendingSize = 64 << 20;
+// Extra room left for the compressed size when deciding whether an entry
+// needs ZIP64.
+constexpr uint64 ZipWriterZip64Margin = 1 << 16;
+// Raw data of at least this size is copied by the kernel. Smaller data is
+// cheaper to write from the mapped archive than to flush the writer for.
+constexpr uint64 ZipWriterKernelCopyMinSize = 1 << 20;
+
+namespace {
+
+double now_seconds() {
+  return std::chrono::duration<double>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+}  // namespace
+
+ZipWriter::ZipWriter(const char* filename)
+    : m_out(std::make_shared<io::AsyncFileWriter>(filename,
+                                                  ZipWriterMaxPendingSize)),
+      m_closed(false) {}
+
+ZipWriter::~ZipWriter() {
+  if (!m_closed) {
+    (void)close();
+  }
+}
+
+bool ZipWriter::is_open() const { return m_out->is_open() && !m_closed; }
+
+size_t ZipWriter::n_entries() const { return m_records.size(); }
+
+void ZipWriter::add_file(const char* filename, CompressionMethod method,
+                         size_t thread_cnt, const CompressionOptions& options,
+                         const std::shared_ptr<CompressionCache>& cache) {
+  if (!is_open()) {
+    log::panic("cannot write to a closed zip");
+  }
+  if (method == CompressionMethod::none) {
+    add_stored_file(filename);
+    return;
+  }
+  trace::Span span("zip_writer::add_file");
+  const double start = now_seconds();
+
+  CompressionCache::Key key{};
+  if (cache) {
+    const io::MappedFile file(filename);
+    if (!file.is_open()) {
+      log::panic("cannot open file '", filename, "'");
+    }
+    const auto n = static_cast<size_t>(file.size());
+    key = CompressionCache::make_key(file.data(), n, method, options);
+    const auto payload = cache->find(key);
+    if (payload && payload->crc32 == crc32::calculate(file.data(), n)) {
+      add_cached_file(filename, file.size(), *payload, start);
+      return;
+    }
+  }
+
+  // The sizes are only known after the data is written, so whether the entry
+  // needs ZIP64 is decided from the size of the source file. Deflate may expand
+  // incompressible data slightly by its block headers, hence the margin.
+  const uint64 size_hint = io::get_file_size(filename);
+  const bool zip64 = size_hint + (size_hint >> 10) + ZipWriterZip64Margin >=
+                     Zip64SizeThreshold;
+
+  EntryRecord record{Version,
+                     DataDescriptorExtractVersion,
+                     GeneralPurposeDataDescriptor,
+                     method,
+                     io::get_last_modify_time(filename),
+                     0,
+                     0,
+                     0,
+                     0,
+                     0,
+                     0,
+                     static_cast<Offset>(m_out->offset()),
+                     filename,
+                     "",
+                     zip64,
+                     {}};
+
+  std::vector<Byte> buffer;
+  write_local_file_header(buffer, record);
+  m_out->write(buffer);
+
+  // The store fallback of FileEntry is not available here since the data has
+  // left before the compressed size is known. Deflate still falls back to
+  // store blocks for incompressible blocks.
+  std::shared_ptr<Compressor> compressor;
+  std::shared_ptr<DeflateCompressor> deflate;
+  switch (method) {
+    case CompressionMethod::none:
+      compressor = std::make_shared<StoreCompressor>();
+      break;
+    case CompressionMethod::deflate:
+      deflate = std::make_shared<DeflateCompressor>(options, thread_cnt);
+      compressor = deflate;
+      break;
+  }
+
+  // With a cache directory, the compressed content is also streamed to a cache
+  // file. A cache kept in memory only is not filled here, since the entry may
+  // not fit in memory.
+  const auto cache_file = cache ? cache->store_stream(key) : nullptr;
+  compressor->begin([this, &cache_file](const Byte* data, size_t n) {
+    m_out->write(data, n);
+    if (cache_file) {
+      cache_file->write(data, n);
+    }
+  });
+  CRC32Value crc = 0;
+  const uint64 uncompressed_size =
+      io::read_chunks(filename, ZipWriterReadChunkSize,
+                      [&crc, &compressor](const Byte* data, size_t n) {
+                        crc = crc32::extend(crc, data, n);
+                        compressor->push(data, n);
+                      });
+  const size_t compressed_size = compressor->finish();
+
+  record.crc32 = crc;
+  record.compressed_size = static_cast<SizeType>(compressed_size);
+  record.uncompressed_size = static_cast<SizeType>(uncompressed_size);
+  if (!record.zip64 && zip64_sizes(record)) {
+    log::panic("'", filename, "' grew too large while being compressed");
+  }
+  if (deflate && deflate->get_sections().size() > 1) {
+    write_section_index(record.extra, deflate->get_sections());
+  }
+  buffer.clear();
+  write_data_descriptor(buffer, record);
+  m_out->write(buffer);
+
+  if (cache_file) {
+    (void)cache_file->finish(method, crc, record.extra);
+  }
+
+  log::log("Added '", filename, "': ", uncompressed_size, " -> ",
+           compressed_size, " bytes");
+  add_stats(record, start, false,
+            deflate ? deflate->get_block_stats() : std::vector<BlockStats>());
+  m_records.push_back(std::move(record));
+}
+
+void ZipWriter::add_stored_file(const char* filename) {
+  trace::Span span("zip_writer::add_stored_file");
+  const double start = now_seconds();
+  // The sizes and crc-32 are known before the data, so they are written in
+  // the local file header and no data descriptor is needed.
+  CRC32Value crc = 0;
+  const uint64 size =
+      io::read_chunks(filename, ZipWriterReadChunkSize,
+                      [&crc](const Byte* data, size_t n) {
+                        crc = crc32::extend(crc, data, n);
+                      });
+  EntryRecord record{Version,
+                     ExtractVersion,
+                     0,
+                     CompressionMethod::none,
+                     io::get_last_modify_time(filename),
+                     crc,
+                     size,
+                     size,
+                     0,
+                     0,
+                     0,
+                     static_cast<Offset>(m_out->offset()),
+                     filename,
+                     "",
+                     false,
+                     {}};
+  std::vector<Byte> buffer;
+  write_local_file_header(buffer, record);
+  m_out->write(buffer);
+
+  uint64 copied = 0;
+#ifndef WIN32
+  const int fd = ::open(filename, O_RDONLY);
+  if (fd >= 0) {
+    copied = m_out->copy_from(fd, 0, size);
+    ::close(fd);
+  }
+#endif
+  // The rest, if the kernel cannot copy it, passes through user space.
+  uint64 written = copied;
+  if (written < size) {
+    (void)io::read_chunks(
+        filename, copied, ZipWriterReadChunkSize,
+        [this, &written, size](const Byte* data, size_t n) {
+          const size_t take =
+              static_cast<size_t>(std::min<uint64>(n, size - written));
+          m_out->write(data, take);
+          written += take;
+        });
+  }
+  if (written != size) {
+    log::panic("'", filename, "' changed while being stored");
+  }
+
+  log::log("Stored '", filename, "': ", size, " bytes, ", copied,
+           " copied by the kernel");
+  add_stats(record, start, false, {});
+  m_records.push_back(std::move(record));
+}
+
+void ZipWriter::add_cached_file(const char* filename,
+                                const uint64 uncompressed_size,
+                                const CompressionCache::Payload& payload,
+                                const double start) {
+  // The sizes and crc-32 are known, so they are written in the local file
+  // header and no data descriptor is needed.
+  EntryRecord record{Version,
+                     ExtractVersion,
+                     0,
+                     payload.method,
+                     io::get_last_modify_time(filename),
+                     payload.crc32,
+                     payload.data.size(),
+                     uncompressed_size,
+                     0,
+                     0,
+                     0,
+                     static_cast<Offset>(m_out->offset()),
+                     filename,
+                     "",
+                     false,
+                     payload.extra};
+  std::vector<Byte> buffer;
+  write_local_file_header(buffer, record);
+  m_out->write(buffer);
+  m_out->write(payload.data.data(), payload.data.size());
+
+  log::log("Reuse the compressed content of '", filename, "'");
+  add_stats(record, start, true, {});
+  m_records.push_back(std::move(record));
+}
+
+bool ZipWriter::add_raw_entry(const ZipReader& reader,
+                              const ZipReader::Entry& entry) {
+  if (!is_open()) {
+    log::panic("cannot write to a closed zip");
+  }
+  const Byte* src = reader.data(entry);
+  if (!src) {
+    return false;
+  }
+  const double start = now_seconds();
+
+  EntryRecord record{Version,
+                     ExtractVersion,
+                     static_cast<GeneralPurpose>(
+                         entry.general_purpose & ~GeneralPurposeDataDescriptor),
+                     entry.method,
+                     entry.last_modify_time,
+                     entry.crc32,
+                     entry.compressed_size,
+                     entry.uncompressed_size,
+                     0,
+                     0,
+                     0,
+                     static_cast<Offset>(m_out->offset()),
+                     std::string(reader.name(entry)),
+                     "",
+                     false,
+                     {}};
+  const io::MappedFile& file = reader.file();
+  if (entry.n_sections) {
+    // The whole extra field: header ID, length and number of sections come
+    // right before the first section.
+    const Byte* p = file.data() + entry.off_sections - 8;
+    record.extra.assign(p, p + 8 + 16 * static_cast<size_t>(entry.n_sections));
+  }
+
+  std::vector<Byte> buffer;
+  write_local_file_header(buffer, record);
+  m_out->write(buffer);
+  uint64 copied = 0;
+#ifndef WIN32
+  if (entry.compressed_size >= ZipWriterKernelCopyMinSize) {
+    copied = m_out->copy_from(file.fd(), src - file.data(),
+                              entry.compressed_size);
+  }
+#endif
+  m_out->write(src + copied,
+               static_cast<size_t>(entry.compressed_size - copied));
+
+  log::log("Copied '", record.filename, "': ", entry.compressed_size,
+           " bytes");
+  add_stats(record, start, true, {});
+  m_records.push_back(std::move(record));
+  return true;
+}
+
+bool ZipWriter::reuse_entry(const ZipReader& reader, const char* filename,
+                            const CompressionMethod method) {
+  const ZipReader::Entry* entry = reader.find(filename);
+  if (!entry || entry->method != method ||
+      entry->uncompressed_size != io::get_file_size(filename)) {
+    return false;
+  }
+  const Timestamp time = io::get_last_modify_time(filename);
+  if (time.time != entry->last_modify_time.time ||
+      time.date != entry->last_modify_time.date) {
+    return false;
+  }
+  return add_raw_entry(reader, *entry);
+}
+
+void ZipWriter::add_stats(const EntryRecord& record, const double start,
+                          const bool reused, std::vector<BlockStats> blocks) {
+  m_stats.push_back(EntryStats{record.filename, record.method,
+                               record.uncompressed_size,
+                               record.compressed_size, now_seconds() - start,
+                               reused, std::move(blocks)});
+}
+
+bool ZipWriter::close() {
+  if (m_closed) {
+    return false;
+  }
+  m_closed = true;
+  if (!m_out->is_open()) {
+    return false;
+  }
+
+  const uint64 off_cd = m_out->offset();
+  std::vector<Byte> buffer;
+  for (const auto& record : m_records) {
+    write_central_directory_file_header(buffer, record);
+  }
+  const size_t len_cd = buffer.size();
+  write_eocd(buffer, m_records.size(), off_cd, len_cd, m_comment);
+  m_out->write(buffer);
+  return m_out->close();
+}
+
+}  // namespace sz
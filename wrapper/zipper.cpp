@@ -1,12 +1,20 @@
 #include "sz/zipper.hpp"
 
-#include "util/byte_util.hpp"
+#include <algorithm>
+#include <atomic>
+#include <numeric>
+#include <thread>
+
+#include "sz/trace.hpp"
+
 #include "util/fs.hpp"
-#include "wrapper/constants.hpp"
+#include "util/positional_writer.hpp"
+#include "wrapper/zip_format.hpp"
 
 namespace sz {
 
 void Zipper::update_buffer() {
+  trace::Span span("zipper::update_buffer");
   m_buffer.clear();
   const size_t n = n_entries();
   std::vector<size_t> header_offset(n);
@@ -27,10 +35,20 @@ void Zipper::update_buffer() {
   }
 
   write_eocd(offset_cd);
+  m_buffer_charge.set(m_buffer.capacity());
 
   m_buffer_ready = true;
 }
 
+std::vector<EntryStats> Zipper::get_stats() const {
+  std::vector<EntryStats> stats;
+  stats.reserve(m_entries.size());
+  for (const auto& entry : m_entries) {
+    stats.push_back(entry.get_stats());
+  }
+  return stats;
+}
+
 bool Zipper::write(const char* filename) const {
   if (!m_buffer_ready) {
     return false;
@@ -43,24 +61,89 @@ bool Zipper::write(const std::string& filename) const {
   return write(filename.c_str());
 }
 
+bool Zipper::write_parallel(const char* filename,
+                            const size_t thread_cnt) const {
+  trace::Span span("zipper::write_parallel");
+  const size_t n = n_entries();
+
+  // The offset of every entry follows from the sizes of the entries before it.
+  std::vector<std::vector<Byte>> local_headers(n);
+  std::vector<uint64> header_offset(n);
+  uint64 offset = 0;
+  for (size_t i = 0; i < n; ++i) {
+    m_entries[i].write_local_file_header(local_headers[i]);
+    header_offset[i] = offset;
+    offset += local_headers[i].size() + m_entries[i].get_compressed_size();
+  }
+
+  const uint64 offset_cd = offset;
+  std::vector<Byte> cd;
+  for (size_t i = 0; i < n; ++i) {
+    m_entries[i].write_central_directory_file_header(cd, header_offset[i]);
+  }
+  sz::write_eocd(cd, n, offset_cd, cd.size(), m_comment);
+
+  io::PositionalFileWriter file(filename, offset_cd + cd.size());
+  if (!file.is_open()) {
+    return false;
+  }
+
+  // Larger entries are taken first so that the workers finish at about the
+  // same time.
+  std::vector<size_t> order(n);
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [this](size_t a, size_t b) {
+    return m_entries[a].get_compressed_size() >
+           m_entries[b].get_compressed_size();
+  });
+
+  std::atomic<size_t> next(0);
+  std::atomic<bool> ok(true);
+  auto work_thread = [&]() {
+    for (size_t k; ok && (k = next.fetch_add(1)) < n;) {
+      const size_t i = order[k];
+      uint64 cur = header_offset[i];
+      if (!file.write_at(cur, local_headers[i].data(),
+                         local_headers[i].size())) {
+        ok = false;
+        return;
+      }
+      cur += local_headers[i].size();
+      m_entries[i].write_file_block([&](const Byte* data, size_t len) {
+        if (!file.write_at(cur, data, len)) {
+          ok = false;
+        }
+        cur += len;
+      });
+    }
+  };
+
+  const size_t worker_cnt = std::max<size_t>(1, std::min(thread_cnt, n));
+  std::vector<std::thread> workers;
+  for (size_t i = 1; i < worker_cnt; ++i) {
+    workers.emplace_back(work_thread);
+  }
+  work_thread();
+  for (auto& worker : workers) {
+    worker.join();
+  }
+
+  // The central directory is written after all entries, so that an
+  // interrupted write does not leave an archive that looks complete.
+  if (ok) {
+    ok = file.write_at(offset_cd, cd.data(), cd.size());
+  }
+  return file.close() && ok;
+}
+
+bool Zipper::write_parallel(const std::string& filename,
+                            const size_t thread_cnt) const {
+  return write_parallel(filename.c_str(), thread_cnt);
+}
+
 void Zipper::write_eocd(size_t off_cd) {
-  const size_t cd_end = m_buffer.size();
-  const size_t header_length = static_cast<size_t>(22) + get_comment_length();
-  Byte* content = new Byte[header_length];
-  Byte* p = &content[0];
-  marshal_32(p, endof_central_directory_file_header_signature);
-  marshal_16(p, 0);  // Number of this disk
-  marshal_16(p, 0);  // Disk where central directory starts
-  // Use the number of entries directly as number of central directory records
-  marshal_16(p, static_cast<uint16>(n_entries()));
-  marshal_16(p, static_cast<uint16>(n_entries()));
-  marshal_32(p, static_cast<uint32>(cd_end - off_cd));
-  marshal_32(p, static_cast<uint32>(off_cd));
-  marshal_16(p, static_cast<uint16>(get_comment_length()));
-  marshal_string(p, m_comment);
-
-  m_buffer.insert(m_buffer.end(), content, content + header_length);
-  delete[] content;
+  sz::write_eocd(m_buffer, n_entries(), off_cd, m_buffer.size() - off_cd,
+                 m_comment);
 }
 
 }  // namespace sz